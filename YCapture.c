@@ -0,0 +1,131 @@
+#include "YCapture.h"
+#include "YProtocol.h"
+
+#include <string.h>
+
+void YCaptureInit(struct YCapture *capture, uint8_t *buffer, uint32_t size,
+	uint32_t (*timestamp_func_ptr)(struct YCapture *capture), uint32_t ticks_per_second, void *user_data)
+{
+	capture->buf_ptr_ = buffer;
+	capture->size_ = size;
+	capture->ticks_per_second_ = ticks_per_second;
+	capture->timestamp_func_ptr_ = timestamp_func_ptr;
+	capture->user_data_ = user_data;
+	YCaptureReset(capture);
+}
+
+void YCaptureReset(struct YCapture *capture)
+{
+	YProtocolDisableIrq();
+	capture->length_ = 0;
+	capture->lost_ = 0;
+	
+	// Without header log can't be replayed, so nothing is recorded into too small buffer
+	if (capture->size_ >= Y_CAPTURE_HEADER_SIZE)
+	{
+		memcpy(capture->buf_ptr_, Y_CAPTURE_MAGIC, Y_CAPTURE_MAGIC_SIZE);
+		capture->buf_ptr_[4] = Y_CAPTURE_VERSION;
+		capture->buf_ptr_[5] = (uint8_t) capture->ticks_per_second_;
+		capture->buf_ptr_[6] = (uint8_t) (capture->ticks_per_second_ >> 8);
+		capture->buf_ptr_[7] = (uint8_t) (capture->ticks_per_second_ >> 16);
+		capture->buf_ptr_[8] = (uint8_t) (capture->ticks_per_second_ >> 24);
+		capture->length_ = Y_CAPTURE_HEADER_SIZE;
+	}
+	else
+	{
+		capture->size_ = 0;
+	}
+	capture->last_timestamp_ = capture->timestamp_func_ptr_(capture);
+	YProtocolEnableIrq();
+}
+
+uint32_t YCaptureRecord(struct YCapture *capture, YBOOL is_recieved, uint8_t byte)
+{
+	uint32_t timestamp, delta, record_size;
+	uint8_t tag = (is_recieved == YTRUE) ? 0 : Y_CAPTURE_TX_FLAG;
+	uint8_t *record_ptr;
+	
+	// Timestamp and record are taken together, so records of nested interrupts keep their order and deltas
+	YProtocolDisableIrq();
+	timestamp = capture->timestamp_func_ptr_(capture);
+	delta = timestamp - capture->last_timestamp_;
+	record_size = (delta < Y_CAPTURE_LONG_DELTA) ? 2 : 6;
+	if (capture->size_ - capture->length_ < record_size)
+	{
+		capture->lost_++;
+		YProtocolEnableIrq();
+		return Y_CAPTURE_FULL_ERROR;
+	}
+	
+	record_ptr = &capture->buf_ptr_[capture->length_];
+	if (delta < Y_CAPTURE_LONG_DELTA)
+	{
+		*record_ptr++ = tag | (uint8_t) delta;
+	}
+	else
+	{
+		*record_ptr++ = tag | Y_CAPTURE_LONG_DELTA;
+		*record_ptr++ = (uint8_t) delta;
+		*record_ptr++ = (uint8_t) (delta >> 8);
+		*record_ptr++ = (uint8_t) (delta >> 16);
+		*record_ptr++ = (uint8_t) (delta >> 24);
+	}
+	*record_ptr = byte;
+	
+	capture->length_ += record_size;
+	capture->last_timestamp_ = timestamp;
+	YProtocolEnableIrq();
+	return Y_CAPTURE_NO_ERROR;
+}
+
+uint32_t YCaptureReadHeader(const uint8_t *log, uint32_t size, uint32_t *ticks_per_second)
+{
+	if (size < Y_CAPTURE_HEADER_SIZE || memcmp(log, Y_CAPTURE_MAGIC, Y_CAPTURE_MAGIC_SIZE) != 0 ||
+		log[4] != Y_CAPTURE_VERSION)
+	{
+		return Y_CAPTURE_HEADER_ERROR;
+	}
+	*ticks_per_second = ((uint32_t) log[5]) | (((uint32_t) log[6]) << 8) | (((uint32_t) log[7]) << 16) |
+		(((uint32_t) log[8]) << 24);
+	return Y_CAPTURE_NO_ERROR;
+}
+
+uint32_t YCaptureReplay(const uint8_t *log, uint32_t size,
+	void (*record_func_ptr)(void *user_data, uint64_t timestamp, YBOOL is_recieved, uint8_t byte), void *user_data)
+{
+	uint32_t position = Y_CAPTURE_HEADER_SIZE;
+	uint64_t timestamp = 0;
+	uint32_t ticks_per_second;
+	uint32_t delta;
+	uint8_t tag;
+	
+	if (YCaptureReadHeader(log, size, &ticks_per_second) != Y_CAPTURE_NO_ERROR)
+	{
+		return Y_CAPTURE_HEADER_ERROR;
+	}
+	
+	while (position < size)
+	{
+		tag = log[position++];
+		delta = tag & Y_CAPTURE_LONG_DELTA;
+		if (delta == Y_CAPTURE_LONG_DELTA)
+		{
+			if (size - position < 4)
+			{
+				return Y_CAPTURE_FORMAT_ERROR;
+			}
+			delta = ((uint32_t) log[position]) | (((uint32_t) log[position + 1]) << 8) |
+				(((uint32_t) log[position + 2]) << 16) | (((uint32_t) log[position + 3]) << 24);
+			position += 4;
+		}
+		if (position == size)
+		{
+			return Y_CAPTURE_FORMAT_ERROR;
+		}
+	
+		// 64-bit sum of deltas doesn't wrap, unlike 32-bit ticks of device
+		timestamp += delta;
+		record_func_ptr(user_data, timestamp, (tag & Y_CAPTURE_TX_FLAG) ? YFALSE : YTRUE, log[position++]);
+	}
+	return Y_CAPTURE_NO_ERROR;
+}
@@ -0,0 +1,109 @@
+#ifndef __YCAPTURE_H_
+#define __YCAPTURE_H_
+
+#include "YBool.h"
+
+#include <stdint.h>
+
+/*!
+ * \brief Capture of bytes which went over the wire. Log begins with header:
+ * - 4 bytes of magic "YCAP"
+ * - 1 byte of version of format, Y_CAPTURE_VERSION
+ * - 4 bytes of ticks per second of timestamp functor (low byte first), 0 if it is unknown
+ * Then log is a sequence of records, every record is a tag byte and a data byte:
+ * - bit 7 of tag is direction, 1 - transmitted byte, 0 - recieved byte
+ * - bits 0..6 of tag are ticks of timestamp functor since previous record,
+ * if there were Y_CAPTURE_LONG_DELTA ticks or more, then bits 0..6 are Y_CAPTURE_LONG_DELTA
+ * and 4 bytes of ticks (low byte first) follow the tag
+ * First record counts ticks since YCaptureInit() or YCaptureReset(). Deltas are differences of 32-bit ticks,
+ * so wrap of timestamp functor is transparent, replay sums them into 64-bit timestamps
+ */
+
+//! some errors
+#define Y_CAPTURE_NO_ERROR 0
+#define Y_CAPTURE_FULL_ERROR 1
+#define Y_CAPTURE_FORMAT_ERROR 2
+#define Y_CAPTURE_HEADER_ERROR 3
+
+//! record format
+#define Y_CAPTURE_TX_FLAG 0x80
+#define Y_CAPTURE_LONG_DELTA 0x7F
+
+//! header format
+#define Y_CAPTURE_MAGIC "YCAP"
+#define Y_CAPTURE_MAGIC_SIZE 4
+#define Y_CAPTURE_VERSION 1
+#define Y_CAPTURE_HEADER_SIZE 9
+
+/*!
+ * \brief struct for store capture information
+ * \member buf_ptr_ pointer to buffer that stores log
+ * \member size_ size of buffer
+ * \member length_ length of log
+ * \member lost_ number of bytes that weren't recorded because buffer is full
+ * \member last_timestamp_ timestamp of previous record
+ * \member ticks_per_second_ ticks per second of timestamp functor, it is written into header
+ * \member timestamp_func_ptr_ functor that returns current ticks, for example of free running timer, it gets capture
+ * \member user_data_ user pointer, for example timer of link
+ */
+struct YCapture
+{
+	uint8_t *buf_ptr_;
+	uint32_t size_;
+	uint32_t length_;
+	uint32_t lost_;
+	uint32_t last_timestamp_;
+	uint32_t ticks_per_second_;
+	uint32_t (*timestamp_func_ptr_)(struct YCapture *capture);
+	void *user_data_;
+};
+
+/*!
+ * \brief init capture, header is written into log
+ * \param[in] pointer to capture
+ * \param[in] buffer for log
+ * \param[in] size of buffer
+ * \param[in] functor that returns current ticks
+ * \param[in] ticks per second of functor, 0 if it is unknown
+ * \param[in] user pointer, it is available to functor as user_data_ of capture
+ */
+void YCaptureInit(struct YCapture *capture, uint8_t *buffer, uint32_t size,
+	uint32_t (*timestamp_func_ptr)(struct YCapture *capture), uint32_t ticks_per_second, void *user_data);
+
+/*!
+ * \brief erase log, only header stays in it
+ * \param[in] pointer to capture
+ */
+void YCaptureReset(struct YCapture *capture);
+
+/*!
+ * \brief append byte to log, can be called in interrupt. Record is appended with disabled interrupts,
+ * because RX, TX and DMA interrupts of protocol share capture, so it mustn't be called with disabled interrupts
+ * \param[in] pointer to capture
+ * \param[in] YTRUE if byte has been recieved, YFALSE if byte has been transmitted
+ * \param[in] value of byte
+ * \return error if something going wrong
+ */
+uint32_t YCaptureRecord(struct YCapture *capture, YBOOL is_recieved, uint8_t byte);
+
+/*!
+ * \brief read header of log
+ * \param[in] log
+ * \param[in] size of log
+ * \param[out] ticks per second of timestamps of log, 0 if it is unknown
+ * \return Y_CAPTURE_HEADER_ERROR if log has no header or has unknown version
+ */
+uint32_t YCaptureReadHeader(const uint8_t *log, uint32_t size, uint32_t *ticks_per_second);
+
+/*!
+ * \brief read log, for example log that has been dumped from device and mapped into memory
+ * \param[in] log
+ * \param[in] size of log
+ * \param[in] functor that is called for every record with ticks since beginning of log
+ * \param[in] user pointer passed to functor
+ * \return Y_CAPTURE_HEADER_ERROR if header is wrong, Y_CAPTURE_FORMAT_ERROR if log is truncated
+ */
+uint32_t YCaptureReplay(const uint8_t *log, uint32_t size,
+	void (*record_func_ptr)(void *user_data, uint64_t timestamp, YBOOL is_recieved, uint8_t byte), void *user_data);
+
+#endif // __YCAPTURE_H_
@@ -1,5 +1,5 @@
-#ifndef __YFIFO_H_
-#define __YFIFO_H_
+#ifndef __YDEBUG_H_
+#define __YDEBUG_H_
 
 #include "YBool.h"
 
@@ -148,4 +148,4 @@
 	#define YASSERT_CONTINUE(_value, _message, _message_size)
 #endif // YDEBUG
 
-#endif // __YFIFO_H_
+#endif // __YDEBUG_H_
@@ -26,163 +26,537 @@
 #define PARSE_FLAG_IS_PARSED 128
 
 /*!
- * \global out_fifo_ FIFO for transmitted data
- * \global in_fifo_ FIFO for recieved data
+ * \brief COBS definitions
+ * \definition COBS_DELIMITER - end of packet
+ * \definition COBS_MAX_CODE - code of block without trailing zero, such block has 254 bytes
+ * \definition COBS_MAX_DECODED_SIZE - function code, maximum data (size of data is 16-bit) and CRC16
  */
-struct YFifo out_fifo_;
-struct YFifo in_fifo_;
+#define COBS_DELIMITER 0x00
+#define COBS_MAX_CODE 0xFF
+#define COBS_MAX_DECODED_SIZE (0xFFFF + 3)
 
 /*!
- * \brief Parse variables
- * \global parse_flag_ - parse flag
- * \global parse_error_ - error byte
- * \global parse_bc_low_ - byte counter, low part
- * \global parse_bc_high_ - byte counter, high part
- * \global parse_bc_ - byte counter
- * \global parse_fc_ - function code
- * \global parse_crc_calc_ - calculated CRC16
- * \global parse_crc_income_ - incoming CRC16
- * \global parse_incoming_data_size_ - copy of the Byte Counter. Used for indicate end of data field
- * \global parse_incoming_data_ - buffer for incoming data
- * \global parse_ptr_ - pointer on the current byte in Data Buffer (parse_incoming_data_)
+ * \brief Definitions of records of outcoming FIFO in multi-producer mode, record is
+ * header (size of packet, low byte first) and packet
+ * \definition RECORD_HEADER_SIZE - size of header
+ * \definition RECORD_COMMIT_FLAG - flag in high byte of header, it is set when packet is written completely
+ * \definition RECORD_MAX_SIZE - maximum size of packet in record
  */
-uint8_t parse_flag_;
-uint8_t parse_error_;
-uint8_t parse_bc_low_;
-uint8_t parse_bc_high_;
-uint16_t parse_bc_;
-uint8_t parse_fc_;
-uint16_t parse_crc_calc_;
-uint16_t parse_crc_income_;
-uint16_t parse_incoming_data_size_;
-uint8_t *parse_incoming_data_ = NULL;
-uint16_t parse_ptr_;
+#define RECORD_HEADER_SIZE 2
+#define RECORD_COMMIT_FLAG 0x80
+#define RECORD_MAX_SIZE 0x7FFF
 
 /*!
- * \brief pointer for storing functors
- * \global packet_process_func_ptr_ - process packet functor
- * \global read_byte_func_ptr_ - recieve packet functor
- * \global send_byte_func_ptr_ - transmit packet functor
- * \global enable_disable_transmit_interrupt_func_ptr_ - enable/disable interrupt functor
+ * \brief Atomic operations for multi-producer mode (GCC builtins)
+ * \definition YProtocolAtomicLoad - load with acquire semantic
+ * \definition YProtocolAtomicStore - store with release semantic
+ * \definition YProtocolAtomicCas - compare and swap, on failure expected value is updated
+ * \definition YProtocolAtomicAdd - add without ordering, for counters
  */
-int32_t (*packet_process_func_ptr_)(void);
-uint8_t (*read_byte_func_ptr_)(void);
-void (*send_byte_func_ptr_)(uint8_t);
-void (*enable_disable_transmit_interrupt_func_ptr_)(YBOOL enabled);
+#define YProtocolAtomicLoad(_ptr) __atomic_load_n((_ptr), __ATOMIC_ACQUIRE)
+#define YProtocolAtomicStore(_ptr, _value) __atomic_store_n((_ptr), (_value), __ATOMIC_RELEASE)
+#define YProtocolAtomicCas(_ptr, _expected_ptr, _desired) \
+	__atomic_compare_exchange_n((_ptr), (_expected_ptr), (_desired), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define YProtocolAtomicAdd(_ptr, _value) __atomic_fetch_add((_ptr), (_value), __ATOMIC_RELAXED)
 
 /*!
- * \brief Timer data
- * \global timer_state - state of the timer, 0 - disabled, 1 - enabled
- * \global use_timer_ - use timer for receiving packet
- * \global ticks_ - maximum ticks between receiving bytes
- * \global current_tick_ - current tick
- * \global start_timer_func_ptr_ - start timer external function
- * \global stop_timer_func_ptr_ - stop timer external function
+ * \brief Statistics helpers, they are empty if YPROTOCOL_STATS isn't defined
+ * \definition YPROTOCOL_STATS_INC - increment counter
+ * \definition YPROTOCOL_STATS_ADD - add value to counter
+ * \definition YPROTOCOL_STATS_CYCLES_BEGIN - remember cycle counter value in local variable _start,
+ * every measured section has own variable, because sections can be nested or interrupted
+ * \definition YPROTOCOL_STATS_CYCLES_END - add cycles from YPROTOCOL_STATS_CYCLES_BEGIN to counter
+ * \definition YPROTOCOL_STATS_SHARED_INC, YPROTOCOL_STATS_SHARED_ADD, YPROTOCOL_STATS_SHARED_CYCLES_END - the same
+ * for counters of sending, they are updated atomically in multi-producer mode
+ * Conditional helpers are single statements (do-while), so they are safe in unbraced if-else
  */
-uint8_t timer_state_ = 0;
-YBOOL use_timer_ = YFALSE;
-unsigned ticks_ = 0;
-unsigned current_tick_ = 0;
-void (*start_timer_func_ptr_)(void) = 0;
-void (*stop_timer_func_ptr_)(void) = 0;
+#ifdef YPROTOCOL_STATS
+	#define YPROTOCOL_STATS_INC(_member) protocol->stats_._member++
+	#define YPROTOCOL_STATS_ADD(_member, _value) protocol->stats_._member += (_value)
+	#define YPROTOCOL_STATS_CYCLES_BEGIN(_start) \
+		_start = (protocol->stats_cycle_counter_func_ptr_ != 0) ? protocol->stats_cycle_counter_func_ptr_(protocol) : 0
+	#define YPROTOCOL_STATS_CYCLES_END(_member, _start) \
+		do \
+		{ \
+			if (protocol->stats_cycle_counter_func_ptr_ != 0) \
+			{ \
+				protocol->stats_._member += protocol->stats_cycle_counter_func_ptr_(protocol) - (_start); \
+			} \
+		} \
+		while (0)
+	#define YPROTOCOL_STATS_SHARED_ADD(_member, _value) \
+		do \
+		{ \
+			if (protocol->multi_producer_ == YTRUE) \
+			{ \
+				YProtocolAtomicAdd(&protocol->stats_._member, (_value)); \
+			} \
+			else \
+			{ \
+				protocol->stats_._member += (_value); \
+			} \
+		} \
+		while (0)
+	#define YPROTOCOL_STATS_SHARED_INC(_member) YPROTOCOL_STATS_SHARED_ADD(_member, 1)
+	#define YPROTOCOL_STATS_SHARED_CYCLES_END(_member, _start) \
+		do \
+		{ \
+			if (protocol->stats_cycle_counter_func_ptr_ != 0) \
+			{ \
+				YPROTOCOL_STATS_SHARED_ADD(_member, protocol->stats_cycle_counter_func_ptr_(protocol) - (_start)); \
+			} \
+		} \
+		while (0)
+#else
+	#define YPROTOCOL_STATS_INC(_member)
+	#define YPROTOCOL_STATS_ADD(_member, _value)
+	#define YPROTOCOL_STATS_CYCLES_BEGIN(_start)
+	#define YPROTOCOL_STATS_CYCLES_END(_member, _start)
+	#define YPROTOCOL_STATS_SHARED_ADD(_member, _value)
+	#define YPROTOCOL_STATS_SHARED_INC(_member)
+	#define YPROTOCOL_STATS_SHARED_CYCLES_END(_member, _start)
+#endif // YPROTOCOL_STATS
 
-void YProtocolStartTimer(void)
+/*!
+ * \brief Tracing helpers, they are empty if YPROTOCOL_TRACE isn't defined
+ * \definition YPROTOCOL_TRACE_RECEIVED - bytes have been recieved, they share timestamp
+ * \definition YPROTOCOL_TRACE_STORED - _count recieved bytes are stored into incoming FIFO from _position
+ * \definition YPROTOCOL_TRACE_MOVED - _count bytes are moved to the beginning of half-duplex arena from _position
+ * \definition YPROTOCOL_TRACE_PARSING - byte at _position of incoming FIFO is going to be parsed
+ * \definition YPROTOCOL_TRACE_PARSING_RECEIVED - byte recieved right now is going to be parsed
+ * \definition YPROTOCOL_TRACE_PARSED - packet has been parsed, number of traced packet is stored into _packet
+ * \definition YPROTOCOL_TRACE_HANDLER_ENTRY - process packet functor is called for traced packet _packet
+ * \definition YPROTOCOL_TRACE_HANDLER_EXIT - process packet functor has returned
+ * \definition YPROTOCOL_TRACE_REPLY_ENQUEUED - packet has been inserted into outcoming FIFO
+ * \definition YPROTOCOL_TRACE_REPLY_SENT - outcoming FIFO is empty
+ */
+#ifdef YPROTOCOL_TRACE
+	#define YPROTOCOL_TRACE_RECEIVED() protocol->trace_rx_now_ = YProtocolTraceNow(protocol)
+	#define YPROTOCOL_TRACE_STORED(_position, _count) YProtocolTraceStored(protocol, _position, _count)
+	#define YPROTOCOL_TRACE_MOVED(_position, _count) YProtocolTraceMoved(protocol, _position, _count)
+	#define YPROTOCOL_TRACE_PARSING(_position) YProtocolTraceParsing(protocol, _position)
+	#define YPROTOCOL_TRACE_PARSING_RECEIVED() YProtocolTraceFirstByte(protocol, protocol->trace_rx_now_, YTRUE)
+	#define YPROTOCOL_TRACE_PARSED(_packet) _packet = YProtocolTraceParsed(protocol)
+	#define YPROTOCOL_TRACE_HANDLER_ENTRY(_packet) YProtocolTraceHandlerEntry(protocol, _packet)
+	#define YPROTOCOL_TRACE_HANDLER_EXIT() YProtocolTraceHandlerExit(protocol)
+	#define YPROTOCOL_TRACE_REPLY_ENQUEUED() YProtocolTraceReplyEnqueued(protocol)
+	#define YPROTOCOL_TRACE_REPLY_SENT() YProtocolTraceReplySent(protocol)
+	
+	//! there is no trace record
+	#define TRACE_NONE 0xFFFFFFFF
+#else
+	#define YPROTOCOL_TRACE_RECEIVED()
+	#define YPROTOCOL_TRACE_STORED(_position, _count)
+	#define YPROTOCOL_TRACE_MOVED(_position, _count)
+	#define YPROTOCOL_TRACE_PARSING(_position)
+	#define YPROTOCOL_TRACE_PARSING_RECEIVED()
+	#define YPROTOCOL_TRACE_PARSED(_packet)
+	#define YPROTOCOL_TRACE_HANDLER_ENTRY(_packet)
+	#define YPROTOCOL_TRACE_HANDLER_EXIT()
+	#define YPROTOCOL_TRACE_REPLY_ENQUEUED()
+	#define YPROTOCOL_TRACE_REPLY_SENT()
+#endif // YPROTOCOL_TRACE
+
+YBOOL YProtocolParserIsIdle(struct YProtocol *protocol)
+{
+	if (protocol->parse_flag_ == 0 && protocol->parse_ptr_ == 0 && protocol->cobs_code_ == 0 &&
+		protocol->parse_error_ == 0)
+	{
+		return YTRUE;
+	}
+	return YFALSE;
+}
+
+#ifdef YPROTOCOL_TRACE
+uint32_t YProtocolTraceNow(struct YProtocol *protocol)
+{
+	if (protocol->trace_timer_func_ptr_ == 0)
+	{
+		return 0;
+	}
+	return protocol->trace_timer_func_ptr_(protocol);
+}
+
+void YProtocolTraceAdd(struct YProtocol *protocol, uint32_t stage, uint32_t begin, uint32_t end)
+{
+	uint32_t delta = end - begin;
+	uint32_t bucket = 0;
+	
+	// Bucket is number of significant bits of latency
+	while (delta != 0 && bucket < YPROTOCOL_TRACE_BUCKETS - 1)
+	{
+		delta >>= 1;
+		bucket++;
+	}
+	protocol->trace_.histograms_[stage][bucket]++;
+}
+
+void YProtocolTraceFinish(struct YProtocol *protocol, struct YProtocolTraceRecord *record)
+{
+	// Record is finished when packet has been processed and reply (if any) has been sent
+	if (!(record->flags_ & Y_TRACE_FLAG_HANDLED) ||
+		((record->flags_ & Y_TRACE_FLAG_REPLY) && !(record->flags_ & Y_TRACE_FLAG_SENT)))
+	{
+		return;
+	}
+	
+	YProtocolTraceAdd(protocol, Y_TRACE_STAGE_QUEUE, record->parsed_, record->handler_entry_);
+	YProtocolTraceAdd(protocol, Y_TRACE_STAGE_HANDLER, record->handler_entry_, record->handler_exit_);
+	if (record->flags_ & Y_TRACE_FLAG_REPLY)
+	{
+		YProtocolTraceAdd(protocol, Y_TRACE_STAGE_REPLY, record->reply_enqueued_, record->reply_sent_);
+	}
+	
+	// Receiving time of first byte is unknown, stages from it are skipped
+	if (!(record->flags_ & Y_TRACE_FLAG_RECEIVED))
+	{
+		return;
+	}
+	YProtocolTraceAdd(protocol, Y_TRACE_STAGE_RECEIVE, record->rx_first_, record->parsed_);
+	if (record->flags_ & Y_TRACE_FLAG_REPLY)
+	{
+		YProtocolTraceAdd(protocol, Y_TRACE_STAGE_TOTAL, record->rx_first_, record->reply_sent_);
+	}
+	else
+	{
+		YProtocolTraceAdd(protocol, Y_TRACE_STAGE_TOTAL, record->rx_first_, record->handler_exit_);
+	}
+}
+
+void YProtocolTraceStored(struct YProtocol *protocol, uint32_t position, uint32_t count)
+{
+	uint32_t i;
+	
+	if (protocol->trace_rx_times_ == NULL)
+	{
+		return;
+	}
+	for (i = 0; i < count; ++i)
+	{
+		protocol->trace_rx_times_[position] = protocol->trace_rx_now_;
+		if (++position == protocol->in_fifo_.size_)
+		{
+			position = 0;
+		}
+	}
+}
+
+void YProtocolTraceMoved(struct YProtocol *protocol, uint32_t position, uint32_t count)
+{
+	if (protocol->trace_rx_times_ != NULL)
+	{
+		memmove(protocol->trace_rx_times_, &protocol->trace_rx_times_[position], count * sizeof(uint32_t));
+	}
+}
+
+void YProtocolTraceFirstByte(struct YProtocol *protocol, uint32_t time, YBOOL valid)
+{
+	// Only the first byte of packet is stamped
+	if (YProtocolParserIsIdle(protocol) == YTRUE)
+	{
+		protocol->trace_rx_first_ = time;
+		protocol->trace_rx_valid_ = valid;
+	}
+}
+
+void YProtocolTraceParsing(struct YProtocol *protocol, uint32_t position)
+{
+	if (protocol->trace_rx_times_ == NULL)
+	{
+		YProtocolTraceFirstByte(protocol, YProtocolTraceNow(protocol), YFALSE);
+		return;
+	}
+	YProtocolTraceFirstByte(protocol, protocol->trace_rx_times_[position], YTRUE);
+}
+
+struct YProtocolTraceRecord* YProtocolTraceRecord(struct YProtocol *protocol, uint32_t packet)
+{
+	// Record of packet is reused by packet YPROTOCOL_TRACE_SIZE later, stamps of old packet are dropped then
+	if (packet == TRACE_NONE || protocol->trace_.count_ - packet > YPROTOCOL_TRACE_SIZE)
+	{
+		return NULL;
+	}
+	return &protocol->trace_.records_[packet % YPROTOCOL_TRACE_SIZE];
+}
+
+uint32_t YProtocolTraceParsed(struct YProtocol *protocol)
+{
+	uint32_t packet = protocol->trace_.count_;
+	struct YProtocolTraceRecord *record = &protocol->trace_.records_[packet % YPROTOCOL_TRACE_SIZE];
+	
+	memset(record, 0, sizeof(*record));
+	record->fc_ = protocol->parse_fc_;
+	record->rx_first_ = protocol->trace_rx_first_;
+	record->parsed_ = YProtocolTraceNow(protocol);
+	if (protocol->trace_rx_valid_ == YTRUE)
+	{
+		record->flags_ = Y_TRACE_FLAG_RECEIVED;
+	}
+	protocol->trace_.count_++;
+	return packet;
+}
+
+void YProtocolTraceHandlerEntry(struct YProtocol *protocol, uint32_t packet)
+{
+	struct YProtocolTraceRecord *record;
+	
+	YProtocolDisableIrq();
+	record = YProtocolTraceRecord(protocol, packet);
+	protocol->trace_current_ = (record != NULL) ? packet : TRACE_NONE;
+	if (record != NULL)
+	{
+		record->handler_entry_ = YProtocolTraceNow(protocol);
+	}
+	YProtocolEnableIrq();
+}
+
+void YProtocolTraceHandlerExit(struct YProtocol *protocol)
+{
+	struct YProtocolTraceRecord *record;
+	
+	YProtocolDisableIrq();
+	record = YProtocolTraceRecord(protocol, protocol->trace_current_);
+	protocol->trace_current_ = TRACE_NONE;
+	if (record != NULL)
+	{
+		record->handler_exit_ = YProtocolTraceNow(protocol);
+		record->flags_ |= Y_TRACE_FLAG_HANDLED;
+		YProtocolTraceFinish(protocol, record);
+	}
+	YProtocolEnableIrq();
+}
+
+void YProtocolTraceReplyEnqueued(struct YProtocol *protocol)
+{
+	struct YProtocolTraceRecord *record;
+	
+	// Only the first packet sent by process packet functor is reply
+	YProtocolDisableIrq();
+	record = YProtocolTraceRecord(protocol, protocol->trace_current_);
+	if (record != NULL && !(record->flags_ & Y_TRACE_FLAG_REPLY))
+	{
+		record->reply_enqueued_ = YProtocolTraceNow(protocol);
+		record->flags_ |= Y_TRACE_FLAG_REPLY;
+		protocol->trace_reply_ = protocol->trace_current_;
+	}
+	YProtocolEnableIrq();
+}
+
+void YProtocolTraceReplySent(struct YProtocol *protocol)
+{
+	struct YProtocolTraceRecord *record = YProtocolTraceRecord(protocol, protocol->trace_reply_);
+	
+	protocol->trace_reply_ = TRACE_NONE;
+	if (record == NULL)
+	{
+		return;
+	}
+	record->reply_sent_ = YProtocolTraceNow(protocol);
+	record->flags_ |= Y_TRACE_FLAG_SENT;
+	YProtocolTraceFinish(protocol, record);
+}
+#endif // YPROTOCOL_TRACE
+
+void YProtocolStartTimer(struct YProtocol *protocol)
 {
-	timer_state_ = 1;
-	current_tick_ = 0;
+	protocol->timer_state_ = 1;
+	protocol->current_tick_ = 0;
 	
-	start_timer_func_ptr_();
+	protocol->start_timer_func_ptr_(protocol);
 }
 
-void YProtocolStopTimer(void)
+void YProtocolStopTimer(struct YProtocol *protocol)
 {
-	timer_state_ = 0;
+	protocol->timer_state_ = 0;
 	
-	stop_timer_func_ptr_();
+	protocol->stop_timer_func_ptr_(protocol);
 }
 
-void YProtocolResetTimer(void)
+void YProtocolResetTimer(struct YProtocol *protocol)
 {
-	current_tick_ = 0;
+	protocol->current_tick_ = 0;
 }
 
-void YProtocolTimerInterrupt(void)
+void YProtocolTimerInterrupt(struct YProtocol *protocol)
 {
-	if (use_timer_ == YTRUE)
+	if (protocol->use_timer_ == YTRUE)
 	{
-		current_tick_++;
+		protocol->current_tick_++;
 		
-		if (current_tick_ >= ticks_)
+		if (protocol->current_tick_ >= protocol->ticks_)
 		{
-			YProtocolStopTimer();
-			YProtocolReinit();
+			YPROTOCOL_STATS_INC(timeouts_);
+			YProtocolStopTimer(protocol);
+			YProtocolReinit(protocol);
 		}
 	}
 }
 
-void YProtocolEnableTimer(unsigned ticks, void (*start_timer_func_ptr)(void), void (*stop_timer_func_ptr)(void))
+void YProtocolEnableTimer(struct YProtocol *protocol, unsigned ticks, void (*start_timer_func_ptr)(struct YProtocol *protocol),
+	void (*stop_timer_func_ptr)(struct YProtocol *protocol))
 {
-	use_timer_ = YTRUE;
-	ticks_ = ticks;
+	protocol->use_timer_ = YTRUE;
+	protocol->ticks_ = ticks;
 	
-	start_timer_func_ptr_ = start_timer_func_ptr;
-	stop_timer_func_ptr_ = stop_timer_func_ptr;
+	protocol->start_timer_func_ptr_ = start_timer_func_ptr;
+	protocol->stop_timer_func_ptr_ = stop_timer_func_ptr;
 }
 
-void YProtocolDisableTimer(void)
+void YProtocolDisableTimer(struct YProtocol *protocol)
 {
-	if (use_timer_ == YTRUE)
+	if (protocol->use_timer_ == YTRUE)
 	{
-		stop_timer_func_ptr_();
-		use_timer_ = YFALSE;
+		protocol->stop_timer_func_ptr_(protocol);
+		protocol->use_timer_ = YFALSE;
 	}
 }
 
-void YProtocolReinit(void)
+void YProtocolReinit(struct YProtocol *protocol)
 {
 	// Reinitialization of the Parse variables
-	//__disable_irq();
+	//YProtocolDisableIrq();
 
-	parse_flag_ = 0;
-	parse_error_ = 0;
-	parse_bc_high_ = 0;
-	parse_bc_low_ = 0;
-	parse_bc_ = 0;
-	parse_fc_ = 0;
-	parse_crc_calc_ = 0xFFFF;
-	parse_crc_income_ = 0;
-	parse_incoming_data_size_ = 0;
-	parse_ptr_ = 0;
-	// If parse_incoming_data_ isn't NULL, free memory
-	if(parse_incoming_data_ != NULL)
+	protocol->parse_flag_ = 0;
+	protocol->parse_error_ = 0;
+	protocol->parse_bc_high_ = 0;
+	protocol->parse_bc_low_ = 0;
+	protocol->parse_bc_ = 0;
+	protocol->parse_fc_ = 0;
+	protocol->parse_crc_calc_ = 0xFFFF;
+	protocol->parse_crc_income_ = 0;
+	protocol->parse_incoming_data_size_ = 0;
+	protocol->parse_ptr_ = 0;
+	protocol->cobs_code_ = 0;
+	protocol->cobs_left_ = 0;
+	// If parse_incoming_data_ isn't NULL, free memory, in COBS mode it points into cobs_buf_,
+	// in half-duplex mode it points into arena, in interrupt parsing mode it points into slot of queue
+	if(protocol->parse_incoming_data_ != NULL)
 	{
-		free(parse_incoming_data_);
-		parse_incoming_data_ = NULL;
+		if (protocol->framing_ == Y_PROTOCOL_FRAMING_LENGTH && protocol->half_duplex_ == YFALSE &&
+			protocol->parse_in_interrupt_ == YFALSE)
+		{
+			free(protocol->parse_incoming_data_);
+		}
+		protocol->parse_incoming_data_ = NULL;
 	}
 
-	//__enable_irq();
+	//YProtocolEnableIrq();
 }
 
-void YProtocolInit(uint32_t buffers_size, uint8_t (*read_byte_func_ptr)(void), void (*send_byte_func_ptr)(uint8_t),
-	int32_t (*process_func_ptr)(void), void (*enable_disable_transmit_interrupt_func_ptr)(YBOOL enabled))
+void YProtocolInitFunctors(struct YProtocol *protocol, uint8_t (*read_byte_func_ptr)(struct YProtocol *protocol),
+	void (*send_byte_func_ptr)(struct YProtocol *protocol, uint8_t byte), int32_t (*process_func_ptr)(struct YProtocol *protocol),
+	void (*enable_disable_transmit_interrupt_func_ptr)(struct YProtocol *protocol, YBOOL enabled))
 {
-	packet_process_func_ptr_ = process_func_ptr;
-	read_byte_func_ptr_ = read_byte_func_ptr;
-	send_byte_func_ptr_ = send_byte_func_ptr;
-	enable_disable_transmit_interrupt_func_ptr_ = enable_disable_transmit_interrupt_func_ptr;
+	// Context can be placed in not zeroed memory, so timer, statistics and parse buffer must be cleared
+	memset(protocol, 0, sizeof(*protocol));
+	
+	protocol->packet_process_func_ptr_ = process_func_ptr;
+	protocol->read_byte_func_ptr_ = read_byte_func_ptr;
+	protocol->send_byte_func_ptr_ = send_byte_func_ptr;
+	protocol->enable_disable_transmit_interrupt_func_ptr_ = enable_disable_transmit_interrupt_func_ptr;
+	
+#ifdef YPROTOCOL_TRACE
+	protocol->trace_current_ = TRACE_NONE;
+	protocol->trace_reply_ = TRACE_NONE;
+#endif // YPROTOCOL_TRACE
 	
-	YProtocolReinit();
+	YProtocolReinit(protocol);
+}
+
+void YProtocolInit(struct YProtocol *protocol, uint32_t buffers_size, uint8_t (*read_byte_func_ptr)(struct YProtocol *protocol),
+	void (*send_byte_func_ptr)(struct YProtocol *protocol, uint8_t byte), int32_t (*process_func_ptr)(struct YProtocol *protocol),
+	void (*enable_disable_transmit_interrupt_func_ptr)(struct YProtocol *protocol, YBOOL enabled))
+{
+	YProtocolInitFunctors(protocol, read_byte_func_ptr, send_byte_func_ptr, process_func_ptr,
+		enable_disable_transmit_interrupt_func_ptr);
 	
 	// FIFOs init
-	in_fifo_.buf_ptr_ = (uint8_t*) malloc (buffers_size);
-	in_fifo_.size_ = buffers_size;
-	out_fifo_.buf_ptr_ = (uint8_t*) malloc (buffers_size);
-	out_fifo_.size_ = buffers_size;
-	YFifo8Flush(&out_fifo_);
-	YFifo8Flush(&in_fifo_);
+	protocol->in_fifo_.buf_ptr_ = (uint8_t*) malloc (buffers_size);
+	protocol->in_fifo_.size_ = buffers_size;
+	protocol->out_fifo_.buf_ptr_ = (uint8_t*) malloc (buffers_size);
+	protocol->out_fifo_.size_ = buffers_size;
+	YFifo8Flush(&protocol->out_fifo_);
+	YFifo8Flush(&protocol->in_fifo_);
+	
+#ifdef YPROTOCOL_TRACE
+	protocol->trace_rx_times_ = (uint32_t*) malloc(buffers_size * sizeof(uint32_t));
+#endif // YPROTOCOL_TRACE
+}
+
+void YProtocolInitHalfDuplex(struct YProtocol *protocol, uint32_t buffers_size,
+	uint8_t (*read_byte_func_ptr)(struct YProtocol *protocol), void (*send_byte_func_ptr)(struct YProtocol *protocol, uint8_t byte),
+	int32_t (*process_func_ptr)(struct YProtocol *protocol),
+	void (*enable_disable_transmit_interrupt_func_ptr)(struct YProtocol *protocol, YBOOL enabled),
+	void (*turnaround_func_ptr)(struct YProtocol *protocol, YBOOL transmit))
+{
+	YProtocolInitFunctors(protocol, read_byte_func_ptr, send_byte_func_ptr, process_func_ptr,
+		enable_disable_transmit_interrupt_func_ptr);
+	
+	protocol->half_duplex_ = YTRUE;
+	protocol->turnaround_func_ptr_ = turnaround_func_ptr;
+	
+	// One arena is incoming buffer, storage of parsed packet (in place) and outcoming FIFO
+	protocol->in_fifo_.buf_ptr_ = (uint8_t*) malloc (buffers_size);
+	protocol->in_fifo_.size_ = buffers_size;
+	protocol->out_fifo_.buf_ptr_ = protocol->in_fifo_.buf_ptr_;
+	protocol->out_fifo_.size_ = buffers_size;
+	YFifo8Flush(&protocol->out_fifo_);
+	protocol->cobs_buf_ = protocol->in_fifo_.buf_ptr_;
+	protocol->cobs_buf_size_ = buffers_size;
+	
+#ifdef YPROTOCOL_TRACE
+	protocol->trace_rx_times_ = (uint32_t*) malloc(buffers_size * sizeof(uint32_t));
+#endif // YPROTOCOL_TRACE
+	
+	turnaround_func_ptr(protocol, YFALSE);
+}
+
+void YProtocolDeinit(struct YProtocol *protocol)
+{
+	YProtocolReinit(protocol);
+	
+	// In half-duplex mode outcoming FIFO and COBS buffer are the arena
+	if (protocol->half_duplex_ == YFALSE)
+	{
+		free(protocol->out_fifo_.buf_ptr_);
+		free(protocol->cobs_buf_);
+	}
+	free(protocol->in_fifo_.buf_ptr_);
+	free(protocol->frames_buf_);
+	
+	protocol->in_fifo_.buf_ptr_ = NULL;
+	protocol->in_fifo_.size_ = 0;
+	protocol->out_fifo_.buf_ptr_ = NULL;
+	protocol->out_fifo_.size_ = 0;
+	protocol->cobs_buf_ = NULL;
+	protocol->cobs_buf_size_ = 0;
+	protocol->frames_buf_ = NULL;
+	protocol->frame_buf_size_ = 0;
+	protocol->frames_head_ = 0;
+	protocol->frames_tail_ = 0;
+	
+#ifdef YPROTOCOL_TRACE
+	free(protocol->trace_rx_times_);
+	protocol->trace_rx_times_ = NULL;
+#endif // YPROTOCOL_TRACE
+}
+
+void YProtocolSetFraming(struct YProtocol *protocol, uint8_t framing)
+{
+	YProtocolReinit(protocol);
+	
+	// In interrupt parsing mode packet is decoded into slot of queue
+	if (framing == Y_PROTOCOL_FRAMING_COBS && protocol->cobs_buf_ == NULL && protocol->parse_in_interrupt_ == YFALSE)
+	{
+		// Decoded packet can't be longer than incoming FIFO
+		protocol->cobs_buf_size_ = protocol->in_fifo_.size_;
+		protocol->cobs_buf_ = (uint8_t*) malloc(protocol->cobs_buf_size_);
+		YPROTOCOL_STATS_INC(allocations_);
+	}
+	protocol->framing_ = framing;
 }
 
-uint16_t YProtocolCalcCRC16(uint8_t* Arr, uint16_t Size, uint16_t CRC16)
+uint16_t YProtocolCalcCRC16(uint8_t* Arr, uint32_t Size, uint16_t CRC16)
 {
 	int i, j;
 	for(i = 0; i < Size; i++)
@@ -199,48 +573,248 @@ uint16_t YProtocolCalcCRC16(uint8_t* Arr, uint16_t Size, uint16_t CRC16)
 	return CRC16;
 }
 
+uint8_t* YProtocolFrameSlot(struct YProtocol *protocol)
+{
+	// Slot at tail of queue is never occupied by queued packet, so interrupt parses next packet there
+	return &protocol->frames_buf_[protocol->frames_tail_ * protocol->frame_buf_size_];
+}
+
+YBOOL YProtocolDataFits(struct YProtocol *protocol, uint32_t data_size)
+{
+	// In interrupt parsing mode data is stored in slot of queue, in half-duplex mode whole packet
+	// (byte counter, function code, data and CRC) is stored in arena, else data is allocated
+	if (protocol->parse_in_interrupt_ == YTRUE && data_size > protocol->frame_buf_size_)
+	{
+		return YFALSE;
+	}
+	if (protocol->half_duplex_ == YTRUE && data_size + 5 > protocol->in_fifo_.size_)
+	{
+		return YFALSE;
+	}
+	return YTRUE;
+}
+
+int32_t YProtocolProcessPacket(struct YProtocol *protocol)
+{
+	int32_t err;
+	uint8_t next_tail;
+	struct YProtocolFrame *frame;
+#ifdef YPROTOCOL_TRACE
+	uint32_t trace_packet;
+#endif // YPROTOCOL_TRACE
+	
+	YPROTOCOL_TRACE_PARSED(trace_packet);
+	
+	if (protocol->parse_in_interrupt_ == YFALSE)
+	{
+		// Packet is processed right now, data is released by YProtocolReinit()
+		protocol->frame_.fc_ = protocol->parse_fc_;
+		protocol->frame_.data_ = protocol->parse_incoming_data_;
+		protocol->frame_.data_size_ = protocol->parse_incoming_data_size_;
+		
+		YPROTOCOL_TRACE_HANDLER_ENTRY(trace_packet);
+		err = protocol->packet_process_func_ptr_(protocol);
+		YPROTOCOL_TRACE_HANDLER_EXIT();
+		YProtocolReinit(protocol);
+		return err;
+	}
+	
+	// Packet is queued for YProtocolThread(), its data stays in slot of queue
+	next_tail = protocol->frames_tail_ + 1;
+	if (next_tail == YPROTOCOL_FRAME_QUEUE_SIZE)
+	{
+		next_tail = 0;
+	}
+	if (next_tail == protocol->frames_head_)
+	{
+		YProtocolReinit(protocol);
+		YPROTOCOL_STATS_INC(error_frame_queue_full_);
+		return Y_PARSE_FRAME_QUEUE_FULL;
+	}
+	
+	frame = &protocol->frames_[protocol->frames_tail_];
+	frame->fc_ = protocol->parse_fc_;
+	frame->data_ = protocol->parse_incoming_data_;
+	frame->data_size_ = protocol->parse_incoming_data_size_;
+#ifdef YPROTOCOL_TRACE
+	frame->trace_ = trace_packet;
+#endif // YPROTOCOL_TRACE
+	protocol->parse_incoming_data_ = NULL;
+	protocol->frames_tail_ = next_tail;
+	
+	YProtocolReinit(protocol);
+	return Y_PARSE_IS_OK;
+}
+
+int32_t YProtocolParseCobs(struct YProtocol *protocol, uint8_t byte)
+{
+	uint16_t crc;
+	uint8_t *buf = protocol->cobs_buf_;
+	uint32_t buf_size = protocol->cobs_buf_size_;
+	
+	// In interrupt parsing mode packet is decoded right into slot of queue
+	if (protocol->parse_in_interrupt_ == YTRUE)
+	{
+		buf = YProtocolFrameSlot(protocol);
+		buf_size = protocol->frame_buf_size_;
+	}
+	// Longer packet can't be decoded with 16-bit size of data, it is error like packet longer than buffer
+	if (buf_size > COBS_MAX_DECODED_SIZE)
+	{
+		buf_size = COBS_MAX_DECODED_SIZE;
+	}
+	
+	if (byte != COBS_DELIMITER)
+	{
+		// After error bytes are skipped until delimiter
+		if (protocol->parse_error_ != 0)
+		{
+			return Y_PARSE_IS_OK;
+		}
+		
+		if (protocol->cobs_left_ == 0)
+		{
+			// It is code byte, previous block (if it isn't first and isn't maximum block) ends with zero
+			if (protocol->cobs_code_ != 0 && protocol->cobs_code_ != COBS_MAX_CODE)
+			{
+				if (protocol->parse_ptr_ == buf_size)
+				{
+					protocol->parse_error_ = 1;
+					return Y_PARSE_IS_OK;
+				}
+				buf[protocol->parse_ptr_++] = 0;
+			}
+			protocol->cobs_code_ = byte;
+			protocol->cobs_left_ = byte - 1;
+		}
+		else
+		{
+			if (protocol->parse_ptr_ == buf_size)
+			{
+				protocol->parse_error_ = 1;
+				return Y_PARSE_IS_OK;
+			}
+			buf[protocol->parse_ptr_++] = byte;
+			protocol->cobs_left_--;
+		}
+		return Y_PARSE_IS_OK;
+	}
+	
+	// Got delimiter, packet is finished
+	
+	// Empty packet, for example delimiter that was sent for resynchronization
+	if (protocol->parse_ptr_ == 0 && protocol->cobs_code_ == 0 && protocol->parse_error_ == 0)
+	{
+		return Y_PARSE_IS_OK;
+	}
+	
+	if (protocol->use_timer_ == YTRUE)
+	{
+		YProtocolStopTimer(protocol);
+	}
+	
+	// Packet is too long or last block is truncated
+	if (protocol->parse_error_ != 0 || protocol->cobs_left_ != 0)
+	{
+		YProtocolReinit(protocol);
+		YPROTOCOL_STATS_INC(error_cobs_);
+		return Y_PARSE_ERROR_COBS;
+	}
+	
+	// Function code and CRC16 are required
+	if (protocol->parse_ptr_ < 3)
+	{
+		YProtocolReinit(protocol);
+		YPROTOCOL_STATS_INC(error_bc_);
+		return Y_PARSE_ERROR_BC;
+	}
+	
+	crc = YProtocolCalcCRC16(buf, protocol->parse_ptr_ - 2, 0xFFFF);
+	protocol->parse_crc_income_ = (uint16_t) buf[protocol->parse_ptr_ - 2];
+	protocol->parse_crc_income_ |= ((uint16_t) buf[protocol->parse_ptr_ - 1]) << 8;
+	if (crc != protocol->parse_crc_income_)
+	{
+		YProtocolReinit(protocol);
+		YPROTOCOL_STATS_INC(error_crc_);
+		return Y_PARSE_ERROR_CRC;
+	}
+	
+	protocol->parse_fc_ = buf[0];
+	protocol->parse_incoming_data_size_ = protocol->parse_ptr_ - 3;
+	protocol->parse_incoming_data_ = (protocol->parse_incoming_data_size_ != 0) ? &buf[1] : NULL;
+	protocol->parse_flag_ = PARSE_FLAG_IS_PARSED;
+	YPROTOCOL_STATS_INC(parsed_frames_);
+	
+	// Packet is processed by YProtocolParse(), processing time isn't parsing time
+	return Y_PARSE_IS_OK;
+}
+
 //! \fixme create timeout
-int32_t YProtocolParse(uint8_t byte)
+int32_t YProtocolParse(struct YProtocol *protocol, uint8_t byte)
 {
+#ifdef YPROTOCOL_STATS
+	uint32_t cycles_start;
+#endif // YPROTOCOL_STATS
+	
+	if (protocol->framing_ == Y_PROTOCOL_FRAMING_COBS)
+	{
+		int32_t err;
+		
+		YPROTOCOL_STATS_CYCLES_BEGIN(cycles_start);
+		YPROTOCOL_STATS_INC(parsed_bytes_);
+		err = YProtocolParseCobs(protocol, byte);
+		YPROTOCOL_STATS_CYCLES_END(parse_cycles_, cycles_start);
+		if (protocol->parse_flag_ & PARSE_FLAG_IS_PARSED)
+		{
+			return YProtocolProcessPacket(protocol);
+		}
+		return err;
+	}
+	
+	YPROTOCOL_STATS_CYCLES_BEGIN(cycles_start);
+	YPROTOCOL_STATS_INC(parsed_bytes_);
+	
 	// Did we get low part of Byte Counter?
-	if (!(parse_flag_ & PARSE_FLAG_BC_L))
+	if (!(protocol->parse_flag_ & PARSE_FLAG_BC_L))
 	{
 		// Didn't get low part Byte Counter, it is beginning of the packet
 		
 		// Save Byte Counter
-		parse_bc_low_ = byte;
+		protocol->parse_bc_low_ = byte;
 		// Set PARSE_FLAG_BC flag
-		parse_flag_ = parse_flag_ | PARSE_FLAG_BC_L;
+		protocol->parse_flag_ = protocol->parse_flag_ | PARSE_FLAG_BC_L;
 	}
 	else 
 	{
 		// Got low part of Byte counter
 		
 		// Did we get high part of byte counter?
-		if (!(parse_flag_ & PARSE_FLAG_BC_H))
+		if (!(protocol->parse_flag_ & PARSE_FLAG_BC_H))
 		{	
 			// Didn't get high part Byte Counter, it is beginning of the packet
 		
 			// Save Byte Counter
-			parse_bc_high_ = byte;
-			parse_bc_ = (uint16_t) parse_bc_high_;
-			parse_bc_ = (parse_bc_ << 8) | ((uint16_t) parse_bc_low_);
+			protocol->parse_bc_high_ = byte;
+			protocol->parse_bc_ = (uint16_t) protocol->parse_bc_high_;
+			protocol->parse_bc_ = (protocol->parse_bc_ << 8) | ((uint16_t) protocol->parse_bc_low_);
 			
-			if (parse_bc_ == 0x00)
+			if (protocol->parse_bc_ == 0x00 || YProtocolDataFits(protocol, protocol->parse_bc_ - 3) == YFALSE)
 			{
-				YProtocolReinit();
-				if (use_timer_ == YTRUE)
+				YProtocolReinit(protocol);
+				if (protocol->use_timer_ == YTRUE)
 				{
-					YProtocolStopTimer();
+					YProtocolStopTimer(protocol);
 				}
+				YPROTOCOL_STATS_INC(error_bc_);
+				YPROTOCOL_STATS_CYCLES_END(parse_cycles_, cycles_start);
 				return Y_PARSE_ERROR_BC;
 			}				
 			
 			// Set PARSE_FLAG_BC flag
-			parse_flag_ = parse_flag_ | PARSE_FLAG_BC_H;
-			parse_flag_ = parse_flag_ | PARSE_FLAG_BC;
+			protocol->parse_flag_ = protocol->parse_flag_ | PARSE_FLAG_BC_H;
+			protocol->parse_flag_ = protocol->parse_flag_ | PARSE_FLAG_BC;
 			// Save Copy Byte Counter
-			parse_incoming_data_size_ = parse_bc_ - 3;
+			protocol->parse_incoming_data_size_ = protocol->parse_bc_ - 3;
 		}
 		else
 		{
@@ -249,30 +823,44 @@ int32_t YProtocolParse(uint8_t byte)
 			// Got Byte Counter
 		
 			// For next bytes except CRCL and CRCH we must calculate CRC16
-			if ((parse_flag_ & PARSE_FLAG_BC) & (!(parse_flag_ & PARSE_FLAG_GD)))
+			if ((protocol->parse_flag_ & PARSE_FLAG_BC) & (!(protocol->parse_flag_ & PARSE_FLAG_GD)))
 			{
-				parse_crc_calc_ = YProtocolCalcCRC16(&byte, 1, parse_crc_calc_);
+				protocol->parse_crc_calc_ = YProtocolCalcCRC16(&byte, 1, protocol->parse_crc_calc_);
 			}
 		
 			// Did we get Function Code?
-			if (!(parse_flag_ & PARSE_FLAG_FC))
+			if (!(protocol->parse_flag_ & PARSE_FLAG_FC))
 			{
 				// Didn't get Function Code
 			
 				// Save Function Code
-				parse_fc_ = byte;
+				protocol->parse_fc_ = byte;
 				// Set PARSE_FLAG_FC flag
-				parse_flag_ = parse_flag_ | PARSE_FLAG_FC;
+				protocol->parse_flag_ = protocol->parse_flag_ | PARSE_FLAG_FC;
 			
-				if (parse_bc_ > 3)
+				if (protocol->parse_bc_ > 3)
 				{
-					// Allocate memory for data
-					parse_incoming_data_ = (uint8_t*) malloc((parse_bc_ - 3));
+					if (protocol->half_duplex_ == YTRUE)
+					{
+						// Data is stored in place, it is the next byte of arena
+						protocol->parse_incoming_data_ = &protocol->in_fifo_.buf_ptr_[protocol->hd_rx_read_];
+					}
+					else if (protocol->parse_in_interrupt_ == YTRUE)
+					{
+						// Data is stored in slot of queue, interrupt doesn't allocate memory
+						protocol->parse_incoming_data_ = YProtocolFrameSlot(protocol);
+					}
+					else
+					{
+						// Allocate memory for data
+						protocol->parse_incoming_data_ = (uint8_t*) malloc((protocol->parse_bc_ - 3));
+						YPROTOCOL_STATS_INC(allocations_);
+					}
 				}
 				else
 				{
 					// We don't have data
-					parse_flag_ = parse_flag_ | PARSE_FLAG_GD;
+					protocol->parse_flag_ = protocol->parse_flag_ | PARSE_FLAG_GD;
 				}
 			}
 			else
@@ -280,21 +868,21 @@ int32_t YProtocolParse(uint8_t byte)
 				// Got Function Code
 			
 				// Did we get all data?
-				if (!(parse_flag_ & PARSE_FLAG_GD))
+				if (!(protocol->parse_flag_ & PARSE_FLAG_GD))
 				{
 					// Didn't get all data
 				
 					// Save data
-					parse_incoming_data_[parse_ptr_] = byte;
-					++parse_ptr_;
+					protocol->parse_incoming_data_[protocol->parse_ptr_] = byte;
+					++protocol->parse_ptr_;
 				
 					// Did we get last byte? If we get last byte then parse_ptr_ equal to parse_incoming_data_size___
-					if (parse_ptr_ == parse_incoming_data_size_)
+					if (protocol->parse_ptr_ == protocol->parse_incoming_data_size_)
 					{
 						// We got last byte
 					
 						// Set PARSE_FLAG_GD flag
-						parse_flag_ = parse_flag_ | PARSE_FLAG_GD;
+						protocol->parse_flag_ = protocol->parse_flag_ | PARSE_FLAG_GD;
 					}
 				}
 				else
@@ -302,53 +890,58 @@ int32_t YProtocolParse(uint8_t byte)
 					// Got all data
 				
 					// Did we get low part of the CRC16?
-					if (!(parse_flag_ & PARSE_FLAG_CRCL))
+					if (!(protocol->parse_flag_ & PARSE_FLAG_CRCL))
 					{
 						// Didn't get low part of the CRC16
 					
 						// Save low part of the CRC16
-						parse_crc_income_ = (uint16_t) byte;
+						protocol->parse_crc_income_ = (uint16_t) byte;
 						// Set PARSE_FLAG_CRCL flag
-						parse_flag_ = parse_flag_ | PARSE_FLAG_CRCL;
+						protocol->parse_flag_ = protocol->parse_flag_ | PARSE_FLAG_CRCL;
 					}
 					else
 					{
 						// Got low part of the CRC16
 					
 						// Did we get high part of the CRC16
-						if (!(parse_flag_ & PARSE_FALG_CRCH))
+						if (!(protocol->parse_flag_ & PARSE_FALG_CRCH))
 						{
 							// Save high part of the CRC16
-							parse_crc_income_ = (parse_crc_income_) | (((uint16_t) byte)<<8);
+							protocol->parse_crc_income_ = (protocol->parse_crc_income_) | (((uint16_t) byte)<<8);
 
 							// Compare incoming CRC16 with calculated CRC16
-							if (parse_crc_income_ == parse_crc_calc_)
+							if (protocol->parse_crc_income_ == protocol->parse_crc_calc_)
 							{
 								// CRC16 is right, packet is parsed
 								
 								int32_t err;
 								
 								// Set flag PARSE_FLAG_IS_PARSED
-								parse_flag_ = parse_flag_ | PARSE_FLAG_IS_PARSED;
+								protocol->parse_flag_ = protocol->parse_flag_ | PARSE_FLAG_IS_PARSED;
+								YPROTOCOL_STATS_INC(parsed_frames_);
 								
-								// Packet was parsed
-								err = packet_process_func_ptr_();
-								YProtocolReinit();
-								if (use_timer_ == YTRUE)
+								// Packet was parsed, processing time isn't parsing time
+								YPROTOCOL_STATS_CYCLES_END(parse_cycles_, cycles_start);
+								err = YProtocolProcessPacket(protocol);
+								YPROTOCOL_STATS_CYCLES_BEGIN(cycles_start);
+								if (protocol->use_timer_ == YTRUE)
 								{
-									YProtocolStopTimer();
+									YProtocolStopTimer(protocol);
 								}
+								YPROTOCOL_STATS_CYCLES_END(parse_cycles_, cycles_start);
 								return err;
 							}
 							else 
 							{
 								// Wrong CRC6, reinitialization of the Parse variables
 							
-								YProtocolReinit();
-								if (use_timer_ == YTRUE)
+								YProtocolReinit(protocol);
+								if (protocol->use_timer_ == YTRUE)
 								{
-									YProtocolStopTimer();
+									YProtocolStopTimer(protocol);
 								}
+								YPROTOCOL_STATS_INC(error_crc_);
+								YPROTOCOL_STATS_CYCLES_END(parse_cycles_, cycles_start);
 								return Y_PARSE_ERROR_CRC;
 							}
 						}
@@ -358,124 +951,970 @@ int32_t YProtocolParse(uint8_t byte)
 		}
 	}
 	
+	YPROTOCOL_STATS_CYCLES_END(parse_cycles_, cycles_start);
 	return Y_PARSE_IS_OK;
 }
 
-void YProtocolSendByte(uint8_t byte)
+uint32_t YProtocolBeginRecord(struct YProtocol *protocol)
 {
-	YFifo8Push(&out_fifo_, byte);
-	enable_disable_transmit_interrupt_func_ptr_(YTRUE);
+	uint32_t size = protocol->out_fifo_.size_;
+	uint32_t first = (protocol->out_fifo_.head_ptr_ + 1) % size;
+	uint32_t second = (first + 1) % size;
+	uint8_t header_high = YProtocolAtomicLoad(&protocol->out_fifo_.buf_ptr_[second]);
+	
+	// Record isn't reserved or isn't committed yet
+	if (!(header_high & RECORD_COMMIT_FLAG))
+	{
+		return YFALSE;
+	}
+	
+	protocol->tx_record_left_ = ((uint32_t) protocol->out_fifo_.buf_ptr_[first]) |
+		(((uint32_t) (header_high & ~RECORD_COMMIT_FLAG)) << 8);
+	
+	// Released bytes must be zero, so commit flag of next record is clear until it is committed
+	protocol->out_fifo_.buf_ptr_[first] = 0;
+	protocol->out_fifo_.buf_ptr_[second] = 0;
+	YProtocolAtomicStore(&protocol->out_fifo_.head_ptr_, second);
+	return YTRUE;
 }
 
-int32_t YProtocolSendPacket(uint8_t func_code, uint8_t *data, uint32_t data_size)
+uint32_t YProtocolPopRecordByte(struct YProtocol *protocol, uint8_t *value)
 {
-	int32_t i, err;
-	uint8_t byte;
-	uint16_t crc = 0xFFFF;
-
-	//__disable_irq();
-	
-	// Byte counter
-	byte = (uint8_t) (data_size + 3); // low part of Byte counter
-	err = YFifo8Push(&out_fifo_, byte);
-	byte = (uint8_t) ((data_size + 3) >> 8); // High part of the Byte counter
-	err = YFifo8Push(&out_fifo_, byte);
-	
-	// Function code
-	YFifo8Push(&out_fifo_, func_code);
-	crc = YProtocolCalcCRC16(&func_code, 1, crc);
+	uint32_t next;
 	
-	// Data
-	for (i = 0; i < data_size; ++i)
+	if (protocol->tx_record_left_ == 0 && YProtocolBeginRecord(protocol) == YFALSE)
 	{
-		err = YFifo8Push(&out_fifo_, data[i]);
-		crc = YProtocolCalcCRC16(&data[i], 1, crc);
+		return Y_FIFO8_EMPTY_ERROR;
 	}
 	
-	// CRC
-	byte = (uint8_t) crc; // Low part of the CRC
-	err = YFifo8Push(&out_fifo_, byte);
-	byte = (uint8_t) (crc >> 8); // High part of the CRC
-	err = YFifo8Push(&out_fifo_, byte);
+	next = protocol->out_fifo_.head_ptr_ + 1;
+	if (next == protocol->out_fifo_.size_)
+	{
+		next = 0;
+	}
+	*value = protocol->out_fifo_.buf_ptr_[next];
+	protocol->out_fifo_.buf_ptr_[next] = 0;
+	YProtocolAtomicStore(&protocol->out_fifo_.head_ptr_, next);
+	protocol->tx_record_left_--;
+	return Y_FIFO8_NO_ERROR;
+}
+
+uint32_t YProtocolReserveRecord(struct YProtocol *protocol, uint32_t packet_size, uint32_t *record_begin)
+{
+	uint32_t size = protocol->out_fifo_.size_;
+	uint32_t record_size = packet_size + RECORD_HEADER_SIZE;
+	uint32_t reserve, head, space;
 	
-	enable_disable_transmit_interrupt_func_ptr_(YTRUE);
+	if (packet_size > RECORD_MAX_SIZE)
+	{
+		return Y_FIFO8_FULL_ERROR;
+	}
 	
-	//__enable_irq();
+	// Producers move reserve pointer by CAS, so every producer gets own part of outcoming FIFO
+	reserve = YProtocolAtomicLoad(&protocol->reserve_ptr_);
+	do
+	{
+		head = YProtocolAtomicLoad(&protocol->out_fifo_.head_ptr_);
+		space = (head + size - reserve - 1) % size;
+		if (record_size > space)
+		{
+			return Y_FIFO8_FULL_ERROR;
+		}
+	}
+	while (!YProtocolAtomicCas(&protocol->reserve_ptr_, &reserve, (reserve + record_size) % size));
 	
-	return err;
+	*record_begin = reserve;
+	return Y_FIFO8_NO_ERROR;
 }
 
-int32_t YProtocolThread(void)
+void YProtocolCommitRecord(struct YProtocol *protocol, uint32_t record_begin, uint32_t packet_size)
 {
-	uint8_t buf;
-	int err;
+	uint32_t size = protocol->out_fifo_.size_;
 	
-	// Get byte from InBuffer
-	__disable_irq();
-	err = YFifo8Pop(&in_fifo_, &buf);
-	__enable_irq();
+	protocol->out_fifo_.buf_ptr_[record_begin] = (uint8_t) packet_size;
+	// Commit flag is written after all bytes of packet
+	YProtocolAtomicStore(&protocol->out_fifo_.buf_ptr_[(record_begin + 1) % size],
+		(uint8_t) ((packet_size >> 8) | RECORD_COMMIT_FLAG));
+}
+
+uint32_t YProtocolWriteByte(struct YProtocol *protocol, uint32_t *position, uint8_t byte)
+{
+	// Without position byte is pushed into outcoming FIFO, else it is written into reserved record
+	if (position == NULL)
+	{
+		return YFifo8Push(&protocol->out_fifo_, byte);
+	}
 	
-	if (err == Y_FIFO8_NO_ERROR)
+	protocol->out_fifo_.buf_ptr_[*position] = byte;
+	if (++(*position) == protocol->out_fifo_.size_)
 	{
-		return YProtocolParse(buf);
+		*position = 0;
 	}
-	return Y_PARSE_FIFO_EMPTY;
+	return Y_FIFO8_NO_ERROR;
 }
 
-int32_t YProtocolInterrupt(YBOOL is_recieved)
+void YProtocolStartDmaTransmit(struct YProtocol *protocol)
 {
-	int32_t err;
-	uint8_t byte;
+	uint32_t first;
 	
-	if (is_recieved)
+	// Must be called with disabled interrupts, DMA transmits the largest contiguous part of outcoming FIFO
+	if (protocol->multi_producer_ == YTRUE && protocol->tx_record_left_ == 0 &&
+		YProtocolBeginRecord(protocol) == YFALSE)
 	{
-		if (use_timer_ == YTRUE)
-		{
-			// if timer started we are receving packet - reset timer
-			// else if timer not started we got new packet
-			if (timer_state_ == 0) // new packet
+		protocol->dma_transmit_size_ = 0;
+		return;
+	}
+	
+	first = protocol->out_fifo_.head_ptr_ + 1;
+	if (first == protocol->out_fifo_.size_)
+	{
+		first = 0;
+	}
+	if (protocol->multi_producer_ == YTRUE)
+	{
+		// Only committed record can be transmitted
+		protocol->dma_transmit_size_ = protocol->out_fifo_.size_ - first;
+		if (protocol->dma_transmit_size_ > protocol->tx_record_left_)
+		{
+			protocol->dma_transmit_size_ = protocol->tx_record_left_;
+		}
+	}
+	else if (protocol->out_fifo_.tail_ptr_ >= first)
+	{
+		protocol->dma_transmit_size_ = protocol->out_fifo_.tail_ptr_ - first;
+	}
+	else
+	{
+		protocol->dma_transmit_size_ = protocol->out_fifo_.size_ - first;
+	}
+	
+	if (protocol->dma_transmit_size_ != 0)
+	{
+		protocol->dma_transmit_func_ptr_(protocol, &protocol->out_fifo_.buf_ptr_[first], protocol->dma_transmit_size_);
+	}
+}
+
+void YProtocolBeginHalfDuplexTransmit(struct YProtocol *protocol)
+{
+	uint32_t size = protocol->out_fifo_.size_;
+	
+	YProtocolDisableIrq();
+	if (protocol->transmitting_ == YFALSE)
+	{
+		// Outcoming FIFO begins after recieved bytes, so data of recieved packet stays valid in packet process functor
+		protocol->out_fifo_.tail_ptr_ = protocol->hd_rx_length_ % size;
+		protocol->out_fifo_.head_ptr_ = (protocol->hd_rx_length_ + size - 1) % size;
+		protocol->transmitting_ = YTRUE;
+		protocol->turnaround_func_ptr_(protocol, YTRUE);
+	}
+	YProtocolEnableIrq();
+}
+
+void YProtocolEndHalfDuplexTransmit(struct YProtocol *protocol)
+{
+	if (protocol->half_duplex_ == YTRUE && protocol->transmitting_ == YTRUE)
+	{
+		protocol->transmitting_ = YFALSE;
+		protocol->turnaround_func_ptr_(protocol, YFALSE);
+	}
+}
+
+void YProtocolStartTransmit(struct YProtocol *protocol)
+{
+	if (protocol->dma_transmit_func_ptr_ == NULL)
+	{
+		protocol->enable_disable_transmit_interrupt_func_ptr_(protocol, YTRUE);
+		return;
+	}
+	
+	YProtocolDisableIrq();
+	if (protocol->dma_transmit_size_ == 0)
+	{
+		YProtocolStartDmaTransmit(protocol);
+	}
+	YProtocolEnableIrq();
+}
+
+void YProtocolSendByte(struct YProtocol *protocol, uint8_t byte)
+{
+	uint32_t record_begin, position;
+	
+	if (protocol->multi_producer_ == YTRUE)
+	{
+		if (YProtocolReserveRecord(protocol, 1, &record_begin) != Y_FIFO8_NO_ERROR)
+		{
+			YPROTOCOL_STATS_SHARED_INC(error_out_fifo_full_);
+			return;
+		}
+		position = (record_begin + RECORD_HEADER_SIZE) % protocol->out_fifo_.size_;
+		YProtocolWriteByte(protocol, &position, byte);
+		YProtocolCommitRecord(protocol, record_begin, 1);
+	}
+	else
+	{
+		if (protocol->half_duplex_ == YTRUE)
+		{
+			YProtocolBeginHalfDuplexTransmit(protocol);
+		}
+		YFifo8Push(&protocol->out_fifo_, byte);
+	}
+	YProtocolStartTransmit(protocol);
+}
+
+uint8_t YProtocolCobsPacketByte(uint8_t func_code, uint8_t *data, uint32_t data_size, uint16_t crc, uint32_t i)
+{
+	if (i == 0)
+	{
+		return func_code;
+	}
+	if (i <= data_size)
+	{
+		return data[i - 1];
+	}
+	if (i == data_size + 1)
+	{
+		return (uint8_t) crc;
+	}
+	return (uint8_t) (crc >> 8);
+}
+
+uint32_t YProtocolCobsPacketBlock(uint8_t func_code, uint8_t *data, uint32_t data_size, uint16_t crc, uint32_t block_begin)
+{
+	uint32_t i = block_begin;
+	
+	// Block ends with zero, with end of packet or after 254 bytes
+	while (i < data_size + 3 && i - block_begin < COBS_MAX_CODE - 1 &&
+		YProtocolCobsPacketByte(func_code, data, data_size, crc, i) != 0)
+	{
+		++i;
+	}
+	return i;
+}
+
+uint32_t YProtocolCobsPacketSize(uint8_t func_code, uint8_t *data, uint32_t data_size, uint16_t crc)
+{
+	uint32_t i = 0, block_end;
+	uint32_t encoded_size = 1; // delimiter
+	
+	for (;;)
+	{
+		block_end = YProtocolCobsPacketBlock(func_code, data, data_size, crc, i);
+		encoded_size += block_end - i + 1;
+		if (block_end == data_size + 3)
+		{
+			return encoded_size;
+		}
+		i = (block_end - i != COBS_MAX_CODE - 1) ? block_end + 1 : block_end;
+	}
+}
+
+uint32_t YProtocolWriteCobsPacket(struct YProtocol *protocol, uint32_t *position, uint8_t func_code, uint8_t *data,
+	uint32_t data_size, uint16_t crc)
+{
+	uint32_t i, j, block_begin;
+	uint32_t err = Y_FIFO8_NO_ERROR;
+	
+	// Every block is code byte and up to 254 non zero bytes, block is written into FIFO directly
+	i = 0;
+	for (;;)
+	{
+		block_begin = i;
+		i = YProtocolCobsPacketBlock(func_code, data, data_size, crc, block_begin);
+		
+		if (YProtocolWriteByte(protocol, position, (uint8_t) (i - block_begin + 1)) != Y_FIFO8_NO_ERROR)
+		{
+			err = Y_FIFO8_FULL_ERROR;
+		}
+		for (j = block_begin; j < i; ++j)
+		{
+			if (YProtocolWriteByte(protocol, position, YProtocolCobsPacketByte(func_code, data, data_size, crc, j)) != Y_FIFO8_NO_ERROR)
+			{
+				err = Y_FIFO8_FULL_ERROR;
+			}
+		}
+		
+		if (i == data_size + 3)
+		{
+			break;
+		}
+		// Zero is replaced by code byte of next block, maximum block isn't terminated by zero
+		if (i - block_begin != COBS_MAX_CODE - 1)
+		{
+			++i;
+		}
+	}
+	
+	if (YProtocolWriteByte(protocol, position, COBS_DELIMITER) != Y_FIFO8_NO_ERROR)
+	{
+		err = Y_FIFO8_FULL_ERROR;
+	}
+	return err;
+}
+
+uint32_t YProtocolWriteLengthPacket(struct YProtocol *protocol, uint32_t *position, uint8_t func_code, uint8_t *data,
+	uint32_t data_size, uint16_t crc)
+{
+	uint32_t i, err;
+	
+	// Byte counter
+	err = YProtocolWriteByte(protocol, position, (uint8_t) (data_size + 3)); // low part of Byte counter
+	err = YProtocolWriteByte(protocol, position, (uint8_t) ((data_size + 3) >> 8)); // High part of the Byte counter
+	
+	// Function code
+	YProtocolWriteByte(protocol, position, func_code);
+	
+	// Data
+	for (i = 0; i < data_size; ++i)
+	{
+		err = YProtocolWriteByte(protocol, position, data[i]);
+	}
+	
+	// CRC
+	err = YProtocolWriteByte(protocol, position, (uint8_t) crc); // Low part of the CRC
+	err = YProtocolWriteByte(protocol, position, (uint8_t) (crc >> 8)); // High part of the CRC
+	return err;
+}
+
+int32_t YProtocolSendPacket(struct YProtocol *protocol, uint8_t func_code, uint8_t *data, uint32_t data_size)
+{
+	uint32_t i, err, packet_size, record_begin, position;
+	uint32_t *position_ptr = NULL;
+	uint16_t crc = 0xFFFF;
+#ifdef YPROTOCOL_STATS
+	uint32_t cycles_start;
+#endif // YPROTOCOL_STATS
+
+	YPROTOCOL_STATS_CYCLES_BEGIN(cycles_start);
+	
+	crc = YProtocolCalcCRC16(&func_code, 1, crc);
+	for (i = 0; i < data_size; ++i)
+	{
+		crc = YProtocolCalcCRC16(&data[i], 1, crc);
+	}
+	
+	if (protocol->framing_ == Y_PROTOCOL_FRAMING_COBS)
+	{
+		packet_size = YProtocolCobsPacketSize(func_code, data, data_size, crc);
+	}
+	else
+	{
+		packet_size = data_size + 5;
+	}
+	
+	if (protocol->half_duplex_ == YTRUE)
+	{
+		YProtocolBeginHalfDuplexTransmit(protocol);
+	}
+	
+	// Several tasks can send packets at the same time, every packet is written into own reserved record
+	if (protocol->multi_producer_ == YTRUE)
+	{
+		err = YProtocolReserveRecord(protocol, packet_size, &record_begin);
+		if (err != Y_FIFO8_NO_ERROR)
+		{
+			YPROTOCOL_STATS_SHARED_INC(error_out_fifo_full_);
+			YPROTOCOL_STATS_SHARED_CYCLES_END(send_cycles_, cycles_start);
+			return err;
+		}
+		position = (record_begin + RECORD_HEADER_SIZE) % protocol->out_fifo_.size_;
+		position_ptr = &position;
+	}
+	
+	if (protocol->framing_ == Y_PROTOCOL_FRAMING_COBS)
+	{
+		err = YProtocolWriteCobsPacket(protocol, position_ptr, func_code, data, data_size, crc);
+	}
+	else
+	{
+		err = YProtocolWriteLengthPacket(protocol, position_ptr, func_code, data, data_size, crc);
+	}
+	
+	if (protocol->multi_producer_ == YTRUE)
+	{
+		YProtocolCommitRecord(protocol, record_begin, packet_size);
+	}
+	
+	YPROTOCOL_TRACE_REPLY_ENQUEUED();
+	YProtocolStartTransmit(protocol);
+	
+	if (err == Y_FIFO8_FULL_ERROR)
+	{
+		YPROTOCOL_STATS_SHARED_INC(error_out_fifo_full_);
+	}
+	YPROTOCOL_STATS_SHARED_INC(sent_frames_);
+	YPROTOCOL_STATS_SHARED_ADD(sent_bytes_, packet_size);
+	YPROTOCOL_STATS_SHARED_CYCLES_END(send_cycles_, cycles_start);
+	
+	return err;
+}
+
+int32_t YProtocolThreadFrames(struct YProtocol *protocol)
+{
+	int32_t err;
+	
+	// Get descriptor of parsed packet
+	YProtocolDisableIrq();
+	if (protocol->frames_head_ == protocol->frames_tail_)
+	{
+		YProtocolEnableIrq();
+		return Y_PARSE_FIFO_EMPTY;
+	}
+	protocol->frame_ = protocol->frames_[protocol->frames_head_];
+	YProtocolEnableIrq();
+	
+	YPROTOCOL_TRACE_HANDLER_ENTRY(protocol->frame_.trace_);
+	err = protocol->packet_process_func_ptr_(protocol);
+	YPROTOCOL_TRACE_HANDLER_EXIT();
+	
+	// Slot is released after processing, so interrupt doesn't overwrite data of processed packet
+	protocol->frame_.data_ = NULL;
+	if (protocol->frames_head_ + 1 == YPROTOCOL_FRAME_QUEUE_SIZE)
+	{
+		protocol->frames_head_ = 0;
+	}
+	else
+	{
+		protocol->frames_head_++;
+	}
+	return err;
+}
+
+int32_t YProtocolThreadHalfDuplex(struct YProtocol *protocol)
+{
+	int32_t err;
+	uint8_t byte;
+	
+	YProtocolDisableIrq();
+	if (protocol->hd_rx_read_ == protocol->hd_rx_length_)
+	{
+		err = Y_PARSE_FIFO_EMPTY;
+		if (YProtocolParserIsIdle(protocol) == YTRUE)
+		{
+			protocol->hd_rx_read_ = 0;
+			protocol->hd_rx_length_ = 0;
+		}
+		else if (protocol->hd_rx_length_ == protocol->in_fifo_.size_)
+		{
+			// Packet doesn't fit into arena, its bytes are dropped. COBS parser skips bytes until
+			// the next delimiter, length parser begins new packet from the next byte
+			if (protocol->framing_ == Y_PROTOCOL_FRAMING_COBS)
 			{
-				YProtocolStartTimer();
+				protocol->parse_error_ = 1;
 			}
 			else
 			{
-				YProtocolResetTimer();
+				YProtocolReinit(protocol);
+				if (protocol->use_timer_ == YTRUE)
+				{
+					YProtocolStopTimer(protocol);
+				}
+				YPROTOCOL_STATS_INC(error_bc_);
+			}
+			protocol->hd_rx_read_ = 0;
+			protocol->hd_rx_length_ = 0;
+			err = Y_PARSE_FIFO_FULL;
+		}
+		YProtocolEnableIrq();
+		return err;
+	}
+	byte = protocol->in_fifo_.buf_ptr_[protocol->hd_rx_read_++];
+	YPROTOCOL_TRACE_PARSING(protocol->hd_rx_read_ - 1);
+	YProtocolEnableIrq();
+	
+	err = YProtocolParse(protocol, byte);
+	
+	// Between packets unparsed bytes are moved to the beginning of arena, so every packet begins there
+	if (protocol->hd_rx_read_ != 0 && YProtocolParserIsIdle(protocol) == YTRUE)
+	{
+		YProtocolDisableIrq();
+		memmove(protocol->in_fifo_.buf_ptr_, &protocol->in_fifo_.buf_ptr_[protocol->hd_rx_read_],
+			protocol->hd_rx_length_ - protocol->hd_rx_read_);
+		YPROTOCOL_TRACE_MOVED(protocol->hd_rx_read_, protocol->hd_rx_length_ - protocol->hd_rx_read_);
+		protocol->hd_rx_length_ -= protocol->hd_rx_read_;
+		protocol->hd_rx_read_ = 0;
+		YProtocolEnableIrq();
+	}
+	return err;
+}
+
+uint32_t YProtocolPushRecieved(struct YProtocol *protocol, uint8_t byte)
+{
+	if (protocol->half_duplex_ == YFALSE)
+	{
+		// Time of free slot at tail is stored even if FIFO is full, no parsed byte uses it then
+		YPROTOCOL_TRACE_STORED(protocol->in_fifo_.tail_ptr_, 1);
+		return YFifo8Push(&protocol->in_fifo_, byte);
+	}
+	
+	// Own transmission is echoed on half-duplex bus
+	if (protocol->transmitting_ == YTRUE)
+	{
+		return Y_FIFO8_NO_ERROR;
+	}
+	if (protocol->hd_rx_length_ == protocol->in_fifo_.size_)
+	{
+		return Y_FIFO8_FULL_ERROR;
+	}
+	YPROTOCOL_TRACE_STORED(protocol->hd_rx_length_, 1);
+	protocol->in_fifo_.buf_ptr_[protocol->hd_rx_length_++] = byte;
+	return Y_FIFO8_NO_ERROR;
+}
+
+int32_t YProtocolThread(struct YProtocol *protocol)
+{
+	uint8_t buf;
+	int err;
+	
+	if (protocol->parse_in_interrupt_ == YTRUE)
+	{
+		return YProtocolThreadFrames(protocol);
+	}
+	if (protocol->half_duplex_ == YTRUE)
+	{
+		return YProtocolThreadHalfDuplex(protocol);
+	}
+	
+	// Get byte from InBuffer
+	YProtocolDisableIrq();
+	err = YFifo8Pop(&protocol->in_fifo_, &buf);
+	if (err == Y_FIFO8_NO_ERROR)
+	{
+		YPROTOCOL_TRACE_PARSING(protocol->in_fifo_.head_ptr_);
+	}
+	YProtocolEnableIrq();
+	
+	if (err == Y_FIFO8_NO_ERROR)
+	{
+		return YProtocolParse(protocol, buf);
+	}
+	return Y_PARSE_FIFO_EMPTY;
+}
+
+int32_t YProtocolReceive(struct YProtocol *protocol, const uint8_t *data, uint32_t data_size)
+{
+	uint32_t i;
+	
+	if (data_size == 0)
+	{
+		return Y_PARSE_IS_OK;
+	}
+	
+	if (protocol->use_timer_ == YTRUE)
+	{
+		if (protocol->timer_state_ == 0) // new packet
+		{
+			YProtocolStartTimer(protocol);
+		}
+		else
+		{
+			YProtocolResetTimer(protocol);
+		}
+	}
+	
+	YPROTOCOL_STATS_ADD(rx_bytes_, data_size);
+	YPROTOCOL_TRACE_RECEIVED();
+	for (i = 0; i < data_size; ++i)
+	{
+		if (protocol->capture_ != NULL)
+		{
+			YCaptureRecord(protocol->capture_, YTRUE, data[i]);
+		}
+		if (protocol->parse_in_interrupt_ == YTRUE)
+		{
+			YPROTOCOL_TRACE_PARSING_RECEIVED();
+			YProtocolParse(protocol, data[i]);
+			continue;
+		}
+		if (YProtocolPushRecieved(protocol, data[i]) == Y_FIFO8_FULL_ERROR)
+		{
+			YPROTOCOL_STATS_ADD(error_fifo_full_, data_size - i);
+			return Y_PARSE_FIFO_FULL;
+		}
+	}
+	return Y_PARSE_IS_OK;
+}
+
+int32_t YProtocolInterrupt(struct YProtocol *protocol, YBOOL is_recieved)
+{
+	int32_t err;
+	uint8_t byte;
+	
+	if (is_recieved)
+	{
+		if (protocol->use_timer_ == YTRUE)
+		{
+			// if timer started we are receving packet - reset timer
+			// else if timer not started we got new packet
+			if (protocol->timer_state_ == 0) // new packet
+			{
+				YProtocolStartTimer(protocol);
+			}
+			else
+			{
+				YProtocolResetTimer(protocol);
 			}
 		}
 		
 		// process incoming byte
-		byte = read_byte_func_ptr_();
-		err = YFifo8Push(&in_fifo_, byte);
+		byte = protocol->read_byte_func_ptr_(protocol);
+		YPROTOCOL_STATS_INC(rx_bytes_);
+		YPROTOCOL_TRACE_RECEIVED();
+		if (protocol->capture_ != NULL)
+		{
+			YCaptureRecord(protocol->capture_, YTRUE, byte);
+		}
+		if (protocol->parse_in_interrupt_ == YTRUE)
+		{
+			YPROTOCOL_TRACE_PARSING_RECEIVED();
+			return YProtocolParse(protocol, byte);
+		}
+		err = YProtocolPushRecieved(protocol, byte);
 		if(err == Y_FIFO8_FULL_ERROR)
 		{
+			YPROTOCOL_STATS_INC(error_fifo_full_);
 			return Y_PARSE_FIFO_FULL;
 		}
 	}
 	else
 	{
 		// process outcoming byte
-		err = YFifo8Pop(&out_fifo_, &byte);
+		if (protocol->multi_producer_ == YTRUE)
+		{
+			err = YProtocolPopRecordByte(protocol, &byte);
+		}
+		else
+		{
+			err = YFifo8Pop(&protocol->out_fifo_, &byte);
+		}
 		if(err == Y_FIFO8_EMPTY_ERROR)
 		{
-			enable_disable_transmit_interrupt_func_ptr_(YFALSE);
+			protocol->enable_disable_transmit_interrupt_func_ptr_(protocol, YFALSE);
+			YProtocolEndHalfDuplexTransmit(protocol);
+			YPROTOCOL_TRACE_REPLY_SENT();
 			return Y_PARSE_OUT_FIFO_EMPTY;
 		}
-		send_byte_func_ptr_(byte);
+		if (protocol->capture_ != NULL)
+		{
+			YCaptureRecord(protocol->capture_, YFALSE, byte);
+		}
+		protocol->send_byte_func_ptr_(protocol, byte);
+		YPROTOCOL_STATS_INC(tx_bytes_);
 	}
 	return Y_PARSE_IS_OK;
 }
 
-uint8_t YProtocolFunctionCode(void)
+uint8_t* YProtocolEnableDmaReceive(struct YProtocol *protocol, uint32_t *size)
+{
+	// Incoming FIFO buffer is released in interrupt parsing mode, but DMA needs it
+	if (protocol->in_fifo_.buf_ptr_ == NULL)
+	{
+		protocol->in_fifo_.buf_ptr_ = (uint8_t*) malloc(protocol->in_fifo_.size_);
+		YPROTOCOL_STATS_INC(allocations_);
+	}
+	
+	YProtocolDisableIrq();
+	
+	// DMA writes from the beginning of buffer, so FIFO is empty when tail is at the beginning
+	protocol->in_fifo_.head_ptr_ = protocol->in_fifo_.size_ - 1;
+	protocol->in_fifo_.tail_ptr_ = 0;
+	protocol->dma_receive_ = YTRUE;
+	YProtocolReinit(protocol);
+	
+	YProtocolEnableIrq();
+	
+	*size = protocol->in_fifo_.size_;
+	return protocol->in_fifo_.buf_ptr_;
+}
+
+int32_t YProtocolDmaReceiveInterrupt(struct YProtocol *protocol, uint32_t position)
+{
+	uint32_t tail = protocol->in_fifo_.tail_ptr_;
+	uint32_t size = protocol->in_fifo_.size_;
+	uint32_t count, space;
+	int32_t err = Y_PARSE_IS_OK;
+	int32_t parse_err;
+	uint8_t byte;
+	
+	if (position == size)
+	{
+		position = 0;
+	}
+	count = (position + size - tail) % size;
+	if (count == 0)
+	{
+		return Y_PARSE_IS_OK;
+	}
+	
+	if (protocol->use_timer_ == YTRUE)
+	{
+		if (protocol->timer_state_ == 0) // new packet
+		{
+			YProtocolStartTimer(protocol);
+		}
+		else
+		{
+			YProtocolResetTimer(protocol);
+		}
+	}
+	YPROTOCOL_STATS_ADD(rx_bytes_, count);
+	YPROTOCOL_TRACE_RECEIVED();
+	
+	// DMA overwrote bytes that weren't parsed yet, they are dropped and current packet fails CRC
+	space = (protocol->in_fifo_.head_ptr_ + size - tail) % size;
+	if (count > space)
+	{
+		protocol->in_fifo_.head_ptr_ = (position + size - 1) % size;
+		protocol->in_fifo_.tail_ptr_ = position;
+		if (protocol->parse_in_interrupt_ == YTRUE)
+		{
+			YProtocolReinit(protocol);
+		}
+		YPROTOCOL_STATS_ADD(error_fifo_full_, count);
+		return Y_PARSE_FIFO_FULL;
+	}
+	YPROTOCOL_TRACE_STORED(tail, count);
+	
+	if (protocol->capture_ != NULL || protocol->parse_in_interrupt_ == YTRUE)
+	{
+		while (tail != position)
+		{
+			byte = protocol->in_fifo_.buf_ptr_[tail];
+			if (protocol->capture_ != NULL)
+			{
+				YCaptureRecord(protocol->capture_, YTRUE, byte);
+			}
+			if (protocol->parse_in_interrupt_ == YTRUE)
+			{
+				YPROTOCOL_TRACE_PARSING_RECEIVED();
+				parse_err = YProtocolParse(protocol, byte);
+				if (parse_err != Y_PARSE_IS_OK)
+				{
+					err = parse_err;
+				}
+			}
+			if (++tail == size)
+			{
+				tail = 0;
+			}
+		}
+	}
+	
+	// In interrupt parsing mode bytes are already parsed and FIFO stays empty
+	if (protocol->parse_in_interrupt_ == YTRUE)
+	{
+		protocol->in_fifo_.head_ptr_ = (position + size - 1) % size;
+	}
+	protocol->in_fifo_.tail_ptr_ = position;
+	return err;
+}
+
+void YProtocolEnableDmaTransmit(struct YProtocol *protocol,
+	void (*dma_transmit_func_ptr)(struct YProtocol *protocol, uint8_t *data, uint32_t size))
+{
+	YProtocolDisableIrq();
+	protocol->dma_transmit_func_ptr_ = dma_transmit_func_ptr;
+	protocol->dma_transmit_size_ = 0;
+	if (dma_transmit_func_ptr != NULL)
+	{
+		YProtocolStartDmaTransmit(protocol);
+	}
+	YProtocolEnableIrq();
+}
+
+int32_t YProtocolDmaTransmitInterrupt(struct YProtocol *protocol)
+{
+	uint32_t i, first;
+	
+	// Transmitted bytes are released
+	first = protocol->out_fifo_.head_ptr_ + 1;
+	if (first == protocol->out_fifo_.size_)
+	{
+		first = 0;
+	}
+	if (protocol->capture_ != NULL)
+	{
+		for (i = 0; i < protocol->dma_transmit_size_; ++i)
+		{
+			YCaptureRecord(protocol->capture_, YFALSE, protocol->out_fifo_.buf_ptr_[first + i]);
+		}
+	}
+	YPROTOCOL_STATS_ADD(tx_bytes_, protocol->dma_transmit_size_);
+	if (protocol->multi_producer_ == YTRUE)
+	{
+		// Released bytes must be zero, see YProtocolBeginRecord()
+		memset(&protocol->out_fifo_.buf_ptr_[first], 0, protocol->dma_transmit_size_);
+		protocol->tx_record_left_ -= protocol->dma_transmit_size_;
+	}
+	YProtocolAtomicStore(&protocol->out_fifo_.head_ptr_,
+		(first + protocol->dma_transmit_size_ + protocol->out_fifo_.size_ - 1) % protocol->out_fifo_.size_);
+	
+	YProtocolStartDmaTransmit(protocol);
+	if (protocol->dma_transmit_size_ == 0)
+	{
+		YProtocolEndHalfDuplexTransmit(protocol);
+		YPROTOCOL_TRACE_REPLY_SENT();
+		return Y_PARSE_OUT_FIFO_EMPTY;
+	}
+	return Y_PARSE_IS_OK;
+}
+
+void YProtocolEnableMultiProducer(struct YProtocol *protocol, YBOOL enabled)
+{
+	YProtocolDisableIrq();
+	
+	// Bytes in outcoming FIFO belong to previous mode, in multi-producer mode free bytes must be zero
+	YFifo8Flush(&protocol->out_fifo_);
+	memset(protocol->out_fifo_.buf_ptr_, 0, protocol->out_fifo_.size_);
+	protocol->reserve_ptr_ = protocol->out_fifo_.tail_ptr_;
+	protocol->tx_record_left_ = 0;
+	protocol->multi_producer_ = enabled;
+	
+	YProtocolEnableIrq();
+}
+
+void YProtocolEnableInterruptParsing(struct YProtocol *protocol, YBOOL enabled)
+{
+	uint8_t *released_fifo = NULL;
+	uint8_t *released_cobs = NULL;
+	uint8_t *released_frames = NULL;
+	
+	// Buffers of new mode are allocated before switching and buffers of previous mode are released after it,
+	// so interrupt always uses allocated buffers and never calls malloc() or free()
+	if (enabled == YTRUE && protocol->frames_buf_ == NULL)
+	{
+		// Every slot keeps data of one packet, packet can't be longer than FIFOs
+		protocol->frame_buf_size_ = protocol->in_fifo_.size_;
+		protocol->frames_buf_ = (uint8_t*) malloc(YPROTOCOL_FRAME_QUEUE_SIZE * protocol->frame_buf_size_);
+		YPROTOCOL_STATS_INC(allocations_);
+	}
+	if (enabled == YFALSE && protocol->in_fifo_.buf_ptr_ == NULL)
+	{
+		protocol->in_fifo_.buf_ptr_ = (uint8_t*) malloc(protocol->in_fifo_.size_);
+		YPROTOCOL_STATS_INC(allocations_);
+	}
+	if (enabled == YFALSE && protocol->framing_ == Y_PROTOCOL_FRAMING_COBS && protocol->cobs_buf_ == NULL)
+	{
+		protocol->cobs_buf_size_ = protocol->in_fifo_.size_;
+		protocol->cobs_buf_ = (uint8_t*) malloc(protocol->cobs_buf_size_);
+		YPROTOCOL_STATS_INC(allocations_);
+	}
+	
+	YProtocolDisableIrq();
+	
+	// Bytes in incoming FIFO and queued packets belong to previous mode, tail stays for DMA
+	protocol->in_fifo_.head_ptr_ = (protocol->in_fifo_.tail_ptr_ + protocol->in_fifo_.size_ - 1) % protocol->in_fifo_.size_;
+	YProtocolReinit(protocol);
+	protocol->frames_head_ = 0;
+	protocol->frames_tail_ = 0;
+	protocol->parse_in_interrupt_ = enabled;
+	if (enabled == YTRUE)
+	{
+		// Incoming FIFO isn't used as byte buffer anymore, except as DMA buffer
+		if (protocol->dma_receive_ == YFALSE)
+		{
+			released_fifo = protocol->in_fifo_.buf_ptr_;
+			protocol->in_fifo_.buf_ptr_ = NULL;
+		}
+		released_cobs = protocol->cobs_buf_;
+		protocol->cobs_buf_ = NULL;
+	}
+	else
+	{
+		released_frames = protocol->frames_buf_;
+		protocol->frames_buf_ = NULL;
+	}
+	
+	YProtocolEnableIrq();
+	
+	free(released_fifo);
+	free(released_cobs);
+	free(released_frames);
+}
+
+uint8_t YProtocolFunctionCode(struct YProtocol *protocol)
+{
+	return protocol->frame_.fc_;
+}
+
+uint8_t* YProtocolParsedData(struct YProtocol *protocol)
+{
+	return protocol->frame_.data_;
+}
+
+uint16_t YProtocolParsedDataSize(struct YProtocol *protocol)
+{
+	return protocol->frame_.data_size_;
+}
+
+void YProtocolSetUserData(struct YProtocol *protocol, void *user_data)
+{
+	protocol->user_data_ = user_data;
+}
+
+void* YProtocolUserData(struct YProtocol *protocol)
+{
+	return protocol->user_data_;
+}
+
+void YProtocolSetCapture(struct YProtocol *protocol, struct YCapture *capture)
+{
+	YProtocolDisableIrq();
+	protocol->capture_ = capture;
+	YProtocolEnableIrq();
+}
+
+void YProtocolGetStats(struct YProtocol *protocol, struct YProtocolStats *stats)
+{
+#ifdef YPROTOCOL_STATS
+	YProtocolDisableIrq();
+	*stats = protocol->stats_;
+	YProtocolEnableIrq();
+#else
+	memset(stats, 0, sizeof(*stats));
+#endif // YPROTOCOL_STATS
+}
+
+void YProtocolResetStats(struct YProtocol *protocol)
+{
+#ifdef YPROTOCOL_STATS
+	YProtocolDisableIrq();
+	memset(&protocol->stats_, 0, sizeof(protocol->stats_));
+	YProtocolEnableIrq();
+#endif // YPROTOCOL_STATS
+}
+
+void YProtocolSetStatsCycleCounter(struct YProtocol *protocol, uint32_t (*cycle_counter_func_ptr)(struct YProtocol *protocol))
+{
+#ifdef YPROTOCOL_STATS
+	protocol->stats_cycle_counter_func_ptr_ = cycle_counter_func_ptr;
+#endif // YPROTOCOL_STATS
+}
+
+void YProtocolSetTraceTimer(struct YProtocol *protocol, uint32_t (*trace_timer_func_ptr)(struct YProtocol *protocol))
 {
-	return parse_fc_;
+#ifdef YPROTOCOL_TRACE
+	protocol->trace_timer_func_ptr_ = trace_timer_func_ptr;
+#endif // YPROTOCOL_TRACE
 }
 
-uint8_t* YProtocolParsedData(void)
+void YProtocolGetTrace(struct YProtocol *protocol, struct YProtocolTrace *trace)
 {
-	return parse_incoming_data_;
+#ifdef YPROTOCOL_TRACE
+	YProtocolDisableIrq();
+	*trace = protocol->trace_;
+	YProtocolEnableIrq();
+#else
+	memset(trace, 0, sizeof(*trace));
+#endif // YPROTOCOL_TRACE
 }
 
-uint16_t YProtocolParsedDataSize(void)
+void YProtocolResetTrace(struct YProtocol *protocol)
 {
-	return parse_incoming_data_size_;
+#ifdef YPROTOCOL_TRACE
+	YProtocolDisableIrq();
+	memset(&protocol->trace_, 0, sizeof(protocol->trace_));
+	protocol->trace_current_ = TRACE_NONE;
+	protocol->trace_reply_ = TRACE_NONE;
+	YProtocolEnableIrq();
+#endif // YPROTOCOL_TRACE
 }
@@ -1,12 +1,48 @@
 #ifndef __YPROTOCOL_H_
 #define __YPROTOCOL_H_
 
-#include "stm32f4xx_conf.h"
-
 #include "YBool.h"
+#include "YCapture.h"
+#include "YFIFO.h"
 
 #include <stdint.h>
 
+//#define YPROTOCOL_STATS
+//#define YPROTOCOL_TRACE
+//#define YPROTOCOL_HOST
+
+/*!
+ * \brief Size of queue of parsed packets that is used if packets are parsed in interrupt,
+ * queue keeps (YPROTOCOL_FRAME_QUEUE_SIZE - 1) packets
+ */
+#ifndef YPROTOCOL_FRAME_QUEUE_SIZE
+	#define YPROTOCOL_FRAME_QUEUE_SIZE 8
+#endif // YPROTOCOL_FRAME_QUEUE_SIZE
+
+/*!
+ * \brief Interrupts control. On the host every protocol context is owned by one thread
+ * that also plays the role of interrupt, so there is nothing to disable
+ */
+#ifndef YPROTOCOL_HOST
+	#include "stm32f4xx_conf.h"
+	#define YProtocolDisableIrq() __disable_irq()
+	#define YProtocolEnableIrq() __enable_irq()
+#else
+	#define YProtocolDisableIrq()
+	#define YProtocolEnableIrq()
+#endif // YPROTOCOL_HOST
+
+/*!
+ * \brief Size of trace ring and number of buckets of latency histograms, used if YPROTOCOL_TRACE is defined.
+ * Tracing also keeps receiving time of every byte of incoming FIFO, it takes 4 bytes of RAM per byte of FIFO
+ */
+#ifndef YPROTOCOL_TRACE_SIZE
+	#define YPROTOCOL_TRACE_SIZE 16
+#endif // YPROTOCOL_TRACE_SIZE
+#ifndef YPROTOCOL_TRACE_BUCKETS
+	#define YPROTOCOL_TRACE_BUCKETS 16
+#endif // YPROTOCOL_TRACE_BUCKETS
+
 /*!
  * \brief Some definitions of status of parsing
  * \definition Y_PARSE_IS_OK - all is well
@@ -18,6 +54,8 @@
  * \definition Y_PARSE_FIFO_EMPTY - parsing bytes FIFO is empty
  * \definition Y_PARSE_OUT_FIFO_FULL - outcoming bytes FIFO is full
  * \definition Y_PARSE_OUT_FIFO_EMPTY - outcoming bytes FIFO is empty
+ * \definition Y_PARSE_ERROR_COBS - wrong COBS encoding or packet is longer than incoming FIFO
+ * \definition Y_PARSE_FRAME_QUEUE_FULL - queue of parsed packets is full, packet is lost
  */
 #define Y_PARSE_IS_OK 0
 #define Y_PARSE_ERROR_BC -1
@@ -28,9 +66,285 @@
 #define Y_PARSE_FIFO_EMPTY -6
 #define Y_PARSE_OUT_FIFO_FULL -7
 #define Y_PARSE_OUT_FIFO_EMPTY -8
+#define Y_PARSE_ERROR_COBS -9
+#define Y_PARSE_FRAME_QUEUE_FULL -10
+
+/*!
+ * \brief Framing of packets, see YProtocolSetFraming()
+ * \definition Y_PROTOCOL_FRAMING_LENGTH - packet begins with byte counter: BC(2) FC(1) DATA CRC16(2)
+ * \definition Y_PROTOCOL_FRAMING_COBS - packet FC(1) DATA CRC16(2) is COBS encoded and ends with 0x00,
+ * receiver finds next packet after any error without timer, overhead is 1 byte per 254 bytes plus delimiter
+ */
+#define Y_PROTOCOL_FRAMING_LENGTH 0
+#define Y_PROTOCOL_FRAMING_COBS 1
+
+/*!
+ * \brief Protocol statistics, collected only if YPROTOCOL_STATS is defined.
+ * All members are 32-bit counters, so the structure can be dumped as is for regression tracking
+ * \member rx_bytes_ - bytes recieved in YProtocolInterrupt()
+ * \member tx_bytes_ - bytes transmitted in YProtocolInterrupt()
+ * \member parsed_bytes_ - bytes passed through YProtocolParse()
+ * \member parsed_frames_ - packets with right CRC
+ * \member sent_frames_ - packets inserted by YProtocolSendPacket()
+ * \member sent_bytes_ - bytes inserted by YProtocolSendPacket()
+ * \member error_bc_ - packets with wrong byte code
+ * \member error_crc_ - packets with wrong CRC
+ * \member error_cobs_ - packets with wrong COBS encoding or too long packets
+ * \member error_frame_queue_full_ - packets lost because queue of parsed packets was full
+ * \member error_fifo_full_ - bytes lost because incoming FIFO was full
+ * \member error_out_fifo_full_ - bytes lost because outcoming FIFO was full
+ * \member timeouts_ - packets dropped by timer
+ * \member allocations_ - calls of malloc()
+ * \member parse_cycles_ - cycles spent in YProtocolParse(), without packet process functor
+ * \member send_cycles_ - cycles spent in YProtocolSendPacket()
+ */
+struct YProtocolStats
+{
+	uint32_t rx_bytes_;
+	uint32_t tx_bytes_;
+	uint32_t parsed_bytes_;
+	uint32_t parsed_frames_;
+	uint32_t sent_frames_;
+	uint32_t sent_bytes_;
+	uint32_t error_bc_;
+	uint32_t error_crc_;
+	uint32_t error_cobs_;
+	uint32_t error_frame_queue_full_;
+	uint32_t error_fifo_full_;
+	uint32_t error_out_fifo_full_;
+	uint32_t timeouts_;
+	uint32_t allocations_;
+	uint32_t parse_cycles_;
+	uint32_t send_cycles_;
+};
+
+/*!
+ * \brief Stages of packet pipeline, latency of each stage is collected into histogram
+ * \definition Y_TRACE_STAGE_RECEIVE - from first recieved byte to last parsed CRC byte
+ * \definition Y_TRACE_STAGE_QUEUE - from last parsed CRC byte to process packet functor entry
+ * \definition Y_TRACE_STAGE_HANDLER - process packet functor
+ * \definition Y_TRACE_STAGE_REPLY - from reply inserting by YProtocolSendPacket() to last transmitted byte of reply
+ * \definition Y_TRACE_STAGE_TOTAL - from first recieved byte to last transmitted byte of reply (or to process packet functor exit)
+ * \definition Y_TRACE_STAGES - number of stages
+ */
+#define Y_TRACE_STAGE_RECEIVE 0
+#define Y_TRACE_STAGE_QUEUE 1
+#define Y_TRACE_STAGE_HANDLER 2
+#define Y_TRACE_STAGE_REPLY 3
+#define Y_TRACE_STAGE_TOTAL 4
+#define Y_TRACE_STAGES 5
+
+/*!
+ * \brief Flags of trace record
+ * \definition Y_TRACE_FLAG_HANDLED - process packet functor has returned
+ * \definition Y_TRACE_FLAG_REPLY - process packet functor has sent reply
+ * \definition Y_TRACE_FLAG_SENT - last byte of reply has been transmitted
+ * \definition Y_TRACE_FLAG_RECEIVED - rx_first_ is receiving time of first byte of packet
+ */
+#define Y_TRACE_FLAG_HANDLED 1
+#define Y_TRACE_FLAG_REPLY 2
+#define Y_TRACE_FLAG_SENT 4
+#define Y_TRACE_FLAG_RECEIVED 8
+
+/*!
+ * \brief Trace record of packet, all timestamps are ticks of trace timer
+ * \member rx_first_ - first byte of packet has been recieved, bytes recieved by one call share timestamp.
+ * Every byte of incoming FIFO keeps its receiving time, so packets queued behind each other keep their own times.
+ * If receiving times couldn't be allocated, rx_first_ is the beginning of parsing of first byte,
+ * Y_TRACE_FLAG_RECEIVED isn't set and Y_TRACE_STAGE_RECEIVE and Y_TRACE_STAGE_TOTAL aren't collected for packet
+ * \member parsed_ - last CRC byte has been parsed
+ * \member handler_entry_ - process packet functor has been called
+ * \member handler_exit_ - process packet functor has returned
+ * \member reply_enqueued_ - first packet sent by process packet functor has been inserted into outcoming FIFO
+ * \member reply_sent_ - outcoming FIFO has become empty after reply
+ * \member fc_ - function code of packet
+ * \member flags_ - flags of record
+ */
+struct YProtocolTraceRecord
+{
+	uint32_t rx_first_;
+	uint32_t parsed_;
+	uint32_t handler_entry_;
+	uint32_t handler_exit_;
+	uint32_t reply_enqueued_;
+	uint32_t reply_sent_;
+	uint8_t fc_;
+	uint8_t flags_;
+};
+
+/*!
+ * \brief Latency trace, collected only if YPROTOCOL_TRACE is defined
+ * \member records_ - ring of last packets, record of packet N is records_[N % YPROTOCOL_TRACE_SIZE]
+ * \member count_ - number of traced packets
+ * \member histograms_ - latency histograms of stages, bucket N counts latencies of N significant bits,
+ * last bucket counts all longer latencies
+ */
+struct YProtocolTrace
+{
+	struct YProtocolTraceRecord records_[YPROTOCOL_TRACE_SIZE];
+	uint32_t count_;
+	uint32_t histograms_[Y_TRACE_STAGES][YPROTOCOL_TRACE_BUCKETS];
+};
 
 /*!
- * \brief This function initializes protocol
+ * \brief Descriptor of parsed packet
+ * \member fc_ - function code
+ * \member data_ - data of packet, NULL if packet hasn't data
+ * \member data_size_ - size of data
+ * \member trace_ - number of traced packet, its record is trace records_[trace_ % YPROTOCOL_TRACE_SIZE]
+ */
+struct YProtocolFrame
+{
+	uint8_t fc_;
+	uint8_t *data_;
+	uint16_t data_size_;
+#ifdef YPROTOCOL_TRACE
+	uint32_t trace_;
+#endif // YPROTOCOL_TRACE
+};
+
+/*!
+ * \brief Protocol context, all functions of protocol are reentrant for different contexts,
+ * so one device can serve several links. Members are private, use functions of protocol
+ * \member out_fifo_ - FIFO for transmitted data
+ * \member in_fifo_ - FIFO for recieved data
+ * \member parse_flag_ - parse flag
+ * \member parse_error_ - error byte, in COBS mode non zero value means skipping bytes until delimiter
+ * \member parse_bc_low_ - byte counter, low part
+ * \member parse_bc_high_ - byte counter, high part
+ * \member parse_bc_ - byte counter
+ * \member parse_fc_ - function code
+ * \member parse_crc_calc_ - calculated CRC16
+ * \member parse_crc_income_ - incoming CRC16
+ * \member parse_incoming_data_size_ - copy of the Byte Counter. Used for indicate end of data field
+ * \member parse_incoming_data_ - buffer for incoming data
+ * \member parse_ptr_ - pointer on the current byte in Data Buffer (parse_incoming_data_ or cobs_buf_)
+ * \member framing_ - framing of packets
+ * \member cobs_code_ - code byte of current COBS block, 0 before first block
+ * \member cobs_left_ - bytes left in current COBS block
+ * \member cobs_buf_ - buffer for decoded COBS packet
+ * \member cobs_buf_size_ - size of cobs_buf_
+ * \member parse_in_interrupt_ - bytes are parsed in YProtocolInterrupt(), see YProtocolEnableInterruptParsing()
+ * \member frames_ - queue of packets parsed in interrupt
+ * \member frames_buf_ - data of packets of queue, slot of frame_buf_size_ bytes per element of frames_
+ * \member frame_buf_size_ - size of slot of frames_buf_
+ * \member frames_head_ - head of frames_, it is changed by YProtocolThread() after packet has been processed
+ * \member frames_tail_ - tail of frames_, it is changed by YProtocolInterrupt()
+ * \member frame_ - packet that is processed by process packet functor
+ * \member dma_receive_ - incoming FIFO buffer is DMA buffer, see YProtocolEnableDmaReceive()
+ * \member dma_transmit_func_ptr_ - start DMA transmission external function, NULL if DMA isn't used for transmission
+ * \member dma_transmit_size_ - size of current DMA transmission, 0 if DMA is idle
+ * \member multi_producer_ - packets can be sent by several tasks at the same time, see YProtocolEnableMultiProducer()
+ * \member reserve_ptr_ - end of reserved part of outcoming FIFO, it is moved by producers with CAS
+ * \member tx_record_left_ - bytes of current record that aren't transmitted yet
+ * \member half_duplex_ - one arena is used for recieving and transmitting, see YProtocolInitHalfDuplex()
+ * \member transmitting_ - half-duplex direction, YTRUE while outcoming FIFO isn't empty
+ * \member turnaround_func_ptr_ - switch direction of half-duplex transceiver external function
+ * \member hd_rx_length_ - number of recieved bytes in arena, it is changed by YProtocolInterrupt()
+ * \member hd_rx_read_ - number of parsed bytes in arena, it is changed by YProtocolThread()
+ * \member packet_process_func_ptr_ - process packet functor
+ * \member read_byte_func_ptr_ - recieve packet functor
+ * \member send_byte_func_ptr_ - transmit packet functor
+ * \member enable_disable_transmit_interrupt_func_ptr_ - enable/disable interrupt functor
+ * \member timer_state_ - state of the timer, 0 - disabled, 1 - enabled
+ * \member use_timer_ - use timer for receiving packet
+ * \member ticks_ - maximum ticks between receiving bytes
+ * \member current_tick_ - current tick
+ * \member start_timer_func_ptr_ - start timer external function
+ * \member stop_timer_func_ptr_ - stop timer external function
+ * \member user_data_ - user pointer, for example link descriptor
+ * \member capture_ - capture of recieved and transmitted bytes, NULL if capture is off
+ * \member stats_ - collected statistics
+ * \member stats_cycle_counter_func_ptr_ - cycle counter external function
+ * \member trace_ - latency trace
+ * \member trace_timer_func_ptr_ - trace timer external function
+ * \member trace_rx_first_ - timestamp of first byte of current parsed packet
+ * \member trace_rx_valid_ - trace_rx_first_ is receiving time of first byte
+ * \member trace_rx_times_ - receiving times of bytes of incoming FIFO (arena in half-duplex mode) by their positions
+ * \member trace_rx_now_ - timestamp of bytes of current receiving call
+ * \member trace_current_ - number of traced packet in process packet functor
+ * \member trace_reply_ - number of traced packet which reply is being transmitted
+ */
+struct YProtocol
+{
+	struct YFifo out_fifo_;
+	struct YFifo in_fifo_;
+	
+	uint8_t parse_flag_;
+	uint8_t parse_error_;
+	uint8_t parse_bc_low_;
+	uint8_t parse_bc_high_;
+	uint16_t parse_bc_;
+	uint8_t parse_fc_;
+	uint16_t parse_crc_calc_;
+	uint16_t parse_crc_income_;
+	uint16_t parse_incoming_data_size_;
+	uint8_t *parse_incoming_data_;
+	uint32_t parse_ptr_;
+	
+	uint8_t framing_;
+	uint8_t cobs_code_;
+	uint8_t cobs_left_;
+	uint8_t *cobs_buf_;
+	uint32_t cobs_buf_size_;
+	
+	YBOOL parse_in_interrupt_;
+	struct YProtocolFrame frames_[YPROTOCOL_FRAME_QUEUE_SIZE];
+	uint8_t *frames_buf_;
+	uint32_t frame_buf_size_;
+	volatile uint8_t frames_head_;
+	volatile uint8_t frames_tail_;
+	struct YProtocolFrame frame_;
+	
+	YBOOL dma_receive_;
+	void (*dma_transmit_func_ptr_)(struct YProtocol *protocol, uint8_t *data, uint32_t size);
+	volatile uint32_t dma_transmit_size_;
+	
+	YBOOL multi_producer_;
+	uint32_t reserve_ptr_;
+	uint32_t tx_record_left_;
+	
+	YBOOL half_duplex_;
+	volatile YBOOL transmitting_;
+	void (*turnaround_func_ptr_)(struct YProtocol *protocol, YBOOL transmit);
+	volatile uint32_t hd_rx_length_;
+	uint32_t hd_rx_read_;
+	
+	int32_t (*packet_process_func_ptr_)(struct YProtocol *protocol);
+	uint8_t (*read_byte_func_ptr_)(struct YProtocol *protocol);
+	void (*send_byte_func_ptr_)(struct YProtocol *protocol, uint8_t byte);
+	void (*enable_disable_transmit_interrupt_func_ptr_)(struct YProtocol *protocol, YBOOL enabled);
+	
+	uint8_t timer_state_;
+	YBOOL use_timer_;
+	unsigned ticks_;
+	unsigned current_tick_;
+	void (*start_timer_func_ptr_)(struct YProtocol *protocol);
+	void (*stop_timer_func_ptr_)(struct YProtocol *protocol);
+	
+	void *user_data_;
+	struct YCapture *capture_;
+	
+#ifdef YPROTOCOL_STATS
+	struct YProtocolStats stats_;
+	uint32_t (*stats_cycle_counter_func_ptr_)(struct YProtocol *protocol);
+#endif // YPROTOCOL_STATS
+	
+#ifdef YPROTOCOL_TRACE
+	struct YProtocolTrace trace_;
+	uint32_t (*trace_timer_func_ptr_)(struct YProtocol *protocol);
+	uint32_t trace_rx_first_;
+	YBOOL trace_rx_valid_;
+	uint32_t *trace_rx_times_;
+	uint32_t trace_rx_now_;
+	uint32_t trace_current_;
+	volatile uint32_t trace_reply_;
+#endif // YPROTOCOL_TRACE
+};
+
+/*!
+ * \brief This function initializes protocol, all functors get context of protocol
+ * \param[in] protocol - context of protocol
  * \param[in] buffers_size - FIFOs buffers size
  * \param[in] read_byte_func_ptr - read bytes functor
  * \param[in] send_byte_func_ptr - send bytes functor
@@ -40,78 +354,266 @@
  * for example, when you use USART and insert data for transmition using YProtocolSendByte() or YProtocolSendPacket(), for begining
  * transmition TC interrupt must been enabled and after outcoming FIFO have been erased TC interrupt must been disabled
  */
-void YProtocolInit(uint32_t buffers_size, uint8_t (*read_byte_func_ptr)(void), void (*send_byte_func_ptr)(uint8_t),
-	int32_t (*process_func_ptr)(void), void (*enable_disable_transmit_interrupt_func_ptr)(YBOOL enabled));
+void YProtocolInit(struct YProtocol *protocol, uint32_t buffers_size, uint8_t (*read_byte_func_ptr)(struct YProtocol *protocol),
+	void (*send_byte_func_ptr)(struct YProtocol *protocol, uint8_t byte), int32_t (*process_func_ptr)(struct YProtocol *protocol),
+	void (*enable_disable_transmit_interrupt_func_ptr)(struct YProtocol *protocol, YBOOL enabled));
+
+/*!
+ * \brief This function initializes protocol for half-duplex bus (for example RS-485), where recieving and
+ * transmitting never overlap. One buffer of buffers_size is used as incoming buffer, as storage of parsed
+ * packet (data isn't allocated, it is parsed in place) and as outcoming FIFO, so RAM usage is a half of YProtocolInit().
+ * Bytes are recieved linearly from the beginning of buffer and recieved bytes are dropped while outcoming FIFO
+ * isn't empty. Packet of process packet functor is valid while it and transmitted packets fit into buffer.
+ * Packet that doesn't fit into buffer is dropped, parsing continues from the next packet (COBS delimiter).
+ * Interrupt parsing, DMA receiving and multi-producer mode can't be used in half-duplex mode
+ * \param[in] protocol - context of protocol
+ * \param[in] buffers_size - arena size
+ * \param[in] read_byte_func_ptr - read bytes functor
+ * \param[in] send_byte_func_ptr - send bytes functor
+ * \param[in] process_func_ptr - proceess incoming packet functor
+ * \param[in] enable_disable_transmit_interrupt_func_ptr - functor that can enable\disable interrupt for transmiting data,
+ * TC interrupt must be used, so direction is switched after the last byte has left transmitter
+ * \param[in] turnaround_func_ptr - functor that switches transceiver direction (for example DE pin of RS-485),
+ * transmit is YTRUE before first transmitted byte and YFALSE after last one
+ */
+void YProtocolInitHalfDuplex(struct YProtocol *protocol, uint32_t buffers_size,
+	uint8_t (*read_byte_func_ptr)(struct YProtocol *protocol), void (*send_byte_func_ptr)(struct YProtocol *protocol, uint8_t byte),
+	int32_t (*process_func_ptr)(struct YProtocol *protocol),
+	void (*enable_disable_transmit_interrupt_func_ptr)(struct YProtocol *protocol, YBOOL enabled),
+	void (*turnaround_func_ptr)(struct YProtocol *protocol, YBOOL transmit));
+
+/*!
+ * \brief This function releases buffers of protocol: FIFOs (or arena), COBS buffer, slots of queued packets
+ * and data of packet being parsed. Disable interrupts of link before, context can be initialized again after it
+ * \param[in] protocol - context of protocol
+ */
+void YProtocolDeinit(struct YProtocol *protocol);
+
+/*!
+ * \brief Select framing of packets, call it after YProtocolInit(). Default framing is Y_PROTOCOL_FRAMING_LENGTH.
+ * In COBS mode decoded packet is stored in buffer of FIFOs size, so packet can't be longer, and its data
+ * can't be longer than 65535 bytes like in length framing, longer packets are Y_PARSE_ERROR_COBS
+ * \param[in] protocol - context of protocol
+ * \param[in] framing - Y_PROTOCOL_FRAMING_LENGTH or Y_PROTOCOL_FRAMING_COBS
+ */
+void YProtocolSetFraming(struct YProtocol *protocol, uint8_t framing);
+
+/*!
+ * \brief Enable parsing of bytes right in YProtocolInterrupt() (and YProtocolReceive()). Only parsed packets are
+ * queued for YProtocolThread(), so process packet functor is called without waiting of parsing in the thread.
+ * Data of packets is stored in YPROTOCOL_FRAME_QUEUE_SIZE slots of buffers_size bytes that are allocated here,
+ * interrupt never allocates memory, longer packets are dropped. Incoming FIFO buffer (and COBS buffer) isn't used
+ * in this mode and is released, except DMA buffer of YProtocolEnableDmaReceive().
+ * Incoming FIFO and queued packets are flushed. Call it from the thread, not from interrupt
+ * \param[in] protocol - context of protocol
+ * \param[in] enabled - YTRUE for parsing in interrupt, YFALSE for parsing in YProtocolThread()
+ */
+void YProtocolEnableInterruptParsing(struct YProtocol *protocol, YBOOL enabled);
+
+/*!
+ * \brief Enable sending of packets by several tasks at the same time without mutex. Every packet atomically
+ * reserves own record in outcoming FIFO and is written there in parallel with other packets,
+ * transmitter sends only committed records in order of reservation. Each record takes 2 bytes of
+ * outcoming FIFO more than packet. Statistics of sending are updated atomically in this mode. Outcoming FIFO is flushed
+ * \param[in] protocol - context of protocol
+ * \param[in] enabled - YTRUE for multi-producer mode
+ */
+void YProtocolEnableMultiProducer(struct YProtocol *protocol, YBOOL enabled);
 
 /*!
  * \brief Enable timer for receiving packet
+ * \param[in] protocol - context of protocol
  * \param[in] ticks - maximum ticks between receiving bytes
  * \param[in] start_timer_func_ptr - start timer external function
  * \param[in] stop_timer_func_ptr - stop timer external function
  */
-void YProtocolEnableTimer(unsigned ticks, void (*start_timer_func_ptr)(void), void (*stop_timer_func_ptr)(void));
+void YProtocolEnableTimer(struct YProtocol *protocol, unsigned ticks, void (*start_timer_func_ptr)(struct YProtocol *protocol),
+	void (*stop_timer_func_ptr)(struct YProtocol *protocol));
 
 /*!
  * \brief Disable timer for receiving packet
+ * \param[in] protocol - context of protocol
  */
-void YProtocolDisableTimer(void);
+void YProtocolDisableTimer(struct YProtocol *protocol);
 
 /*!
  * \brief This function must be used in interrupt of timer
+ * \param[in] protocol - context of protocol
  */
-void YProtocolTimerInterrupt(void);
+void YProtocolTimerInterrupt(struct YProtocol *protocol);
 	
 /*!
  * \brief Function reinitializes parse variables and flush buffer for incoming data
+ * \param[in] protocol - context of protocol
  */
-void YProtocolReinit(void);
+void YProtocolReinit(struct YProtocol *protocol);
 
 /*!
  * \brief It is main function of protocol, use it in a thread or infinite loop
+ * \param[in] protocol - context of protocol
  * \retval status of parsing
  */
-int32_t YProtocolThread(void);
+int32_t YProtocolThread(struct YProtocol *protocol);
 
 /*!
  * \brief It is interrupt function of protocol, call it in interrupt of reciever/transmitter,
  * for example, in USART interrupt
+ * \param[in] protocol - context of protocol
  * \param[in] is_recieved - if interrupt uccured when byte have been recieved this param must be YTRUE
  * else YFALSE (for transmite)
  * \retval status of parsing
  */
-int32_t YProtocolInterrupt(YBOOL is_recieved);
+int32_t YProtocolInterrupt(struct YProtocol *protocol, YBOOL is_recieved);
+
+/*!
+ * \brief This function inserts block of recieved bytes into incoming FIFO, use it instead of
+ * YProtocolInterrupt() for recieving when bytes are read by blocks, for example from socket or pty.
+ * It must be called from the same thread as YProtocolThread() or from interrupt
+ * \param[in] protocol - context of protocol
+ * \param[in] data - recieved bytes
+ * \param[in] data_size - number of recieved bytes
+ * \retval Y_PARSE_FIFO_FULL if FIFO hasn't space for all bytes, rest of bytes are lost
+ */
+int32_t YProtocolReceive(struct YProtocol *protocol, const uint8_t *data, uint32_t data_size);
+
+/*!
+ * \brief This function switches recieving to circular DMA. Incoming FIFO buffer becomes DMA buffer,
+ * configure DMA in circular mode from the beginning of returned buffer, and call YProtocolDmaReceiveInterrupt()
+ * in half-transfer, transfer-complete and idle-line interrupts. Between two calls DMA mustn't write
+ * more than half of buffer. YProtocolInterrupt() mustn't be used for recieving anymore
+ * \param[in] protocol - context of protocol
+ * \param[out] size - size of DMA buffer
+ * \retval DMA buffer
+ */
+uint8_t* YProtocolEnableDmaReceive(struct YProtocol *protocol, uint32_t *size);
+
+/*!
+ * \brief It is interrupt function of DMA reciever, call it in half-transfer, transfer-complete
+ * and idle-line interrupts
+ * \param[in] protocol - context of protocol
+ * \param[in] position - DMA write position in buffer, for example (size - NDTR)
+ * \retval Y_PARSE_FIFO_FULL if DMA overwrote unparsed bytes, they are lost;
+ * in interrupt parsing mode status of parsing
+ */
+int32_t YProtocolDmaReceiveInterrupt(struct YProtocol *protocol, uint32_t position);
+
+/*!
+ * \brief This function switches transmission to DMA. Functor must start DMA transmission of given bytes,
+ * the bytes stay in outcoming FIFO until YProtocolDmaTransmitInterrupt() is called.
+ * enable_disable_transmit_interrupt_func_ptr and YProtocolInterrupt() aren't used for transmission anymore
+ * \param[in] protocol - context of protocol
+ * \param[in] dma_transmit_func_ptr - start DMA transmission functor, NULL switches transmission back to interrupts
+ */
+void YProtocolEnableDmaTransmit(struct YProtocol *protocol,
+	void (*dma_transmit_func_ptr)(struct YProtocol *protocol, uint8_t *data, uint32_t size));
+
+/*!
+ * \brief It is interrupt function of DMA transmitter, call it in transfer-complete interrupt.
+ * Next contiguous part of outcoming FIFO is started if it isn't empty
+ * \param[in] protocol - context of protocol
+ * \retval Y_PARSE_OUT_FIFO_EMPTY if there is nothing to transmit
+ */
+int32_t YProtocolDmaTransmitInterrupt(struct YProtocol *protocol);
 
 /*!
  * \brief This function inserts byte into FIFO that will have been transmitted
+ * \param[in] protocol - context of protocol
  * \paran[in] byte - byte for transmition
  */
-void YProtocolSendByte(uint8_t byte);
+void YProtocolSendByte(struct YProtocol *protocol, uint8_t byte);
 
 /*!
- * \brief This function inserts packet into FIFO that will have been transmitted
+ * \brief This function inserts packet into FIFO that will have been transmitted,
+ * in multi-producer mode it can be called by several tasks at the same time
+ * \param[in] protocol - context of protocol
  * \param[in] func_code - function code of packet
  * \param[in] data - data for transmition
  * \param[in] data_size - sze of data that will have been transmitted
  * \retval status of parsing
  */
-int32_t YProtocolSendPacket(unsigned char func_code, unsigned char *data, uint32_t data_size);
+int32_t YProtocolSendPacket(struct YProtocol *protocol, unsigned char func_code, unsigned char *data, uint32_t data_size);
 
 /*!
  * \brief Function helps to know function code of recieved packet
+ * \param[in] protocol - context of protocol
  * \retval function code of recieved packet
  */
-uint8_t YProtocolFunctionCode(void);
+uint8_t YProtocolFunctionCode(struct YProtocol *protocol);
 
 /*!
  * \brief Function helps to know data of recieved packet
+ * \param[in] protocol - context of protocol
  * \retval data of recieved packet
  */
-uint8_t* YProtocolParsedData(void);
+uint8_t* YProtocolParsedData(struct YProtocol *protocol);
 
 /*!
  * \brief Function helps to know size of data of recieved packet
+ * \param[in] protocol - context of protocol
  * \retval size of data of recieved packet
  */
-uint16_t YProtocolParsedDataSize(void);
+uint16_t YProtocolParsedDataSize(struct YProtocol *protocol);
+
+/*!
+ * \brief Function stores user pointer in context, for example link descriptor for functors
+ * \param[in] protocol - context of protocol
+ * \param[in] user_data - user pointer
+ */
+void YProtocolSetUserData(struct YProtocol *protocol, void *user_data);
+
+/*!
+ * \brief Function helps to know user pointer stored in context
+ * \param[in] protocol - context of protocol
+ * \retval user pointer
+ */
+void* YProtocolUserData(struct YProtocol *protocol);
+
+/*!
+ * \brief Function turns on capture of all bytes that go through YProtocolInterrupt() and YProtocolReceive()
+ * \param[in] protocol - context of protocol
+ * \param[in] capture - initialized capture, NULL turns capture off
+ */
+void YProtocolSetCapture(struct YProtocol *protocol, struct YCapture *capture);
+
+/*!
+ * \brief Function copies collected statistics, all counters are zero if YPROTOCOL_STATS isn't defined
+ * \param[in] protocol - context of protocol
+ * \param[out] stats - copy of statistics
+ */
+void YProtocolGetStats(struct YProtocol *protocol, struct YProtocolStats *stats);
+
+/*!
+ * \brief Function resets collected statistics
+ * \param[in] protocol - context of protocol
+ */
+void YProtocolResetStats(struct YProtocol *protocol);
+
+/*!
+ * \brief Set cycle counter for statistics, for example DWT->CYCCNT reader on Cortex-M
+ * or rdtsc on host. Without cycle counter parse_cycles_ and send_cycles_ stay zero
+ * \param[in] protocol - context of protocol
+ * \param[in] cycle_counter_func_ptr - functor that returns current cycle count
+ */
+void YProtocolSetStatsCycleCounter(struct YProtocol *protocol, uint32_t (*cycle_counter_func_ptr)(struct YProtocol *protocol));
+
+/*!
+ * \brief Set timer for latency trace, for example free running timer of microseconds
+ * \param[in] protocol - context of protocol
+ * \param[in] trace_timer_func_ptr - functor that returns current ticks
+ */
+void YProtocolSetTraceTimer(struct YProtocol *protocol, uint32_t (*trace_timer_func_ptr)(struct YProtocol *protocol));
+
+/*!
+ * \brief Function copies latency trace, for example for dumping to host, trace is zero if YPROTOCOL_TRACE isn't defined
+ * \param[in] protocol - context of protocol
+ * \param[out] trace - copy of trace
+ */
+void YProtocolGetTrace(struct YProtocol *protocol, struct YProtocolTrace *trace);
+
+/*!
+ * \brief Function resets latency trace
+ * \param[in] protocol - context of protocol
+ */
+void YProtocolResetTrace(struct YProtocol *protocol);
 
 #endif /*__YPROTOCOL_H_*/
@@ -0,0 +1,424 @@
+#include "YLinkSim.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef YPROTOCOL_HOST
+	#error "YLinkSim calls interrupt functions from thread, it must be built with YPROTOCOL_HOST"
+#endif // YPROTOCOL_HOST
+
+//! function code of simulated packets
+#define Y_LINK_SIM_FC 1
+
+//! bits on the wire per byte
+#define Y_LINK_SIM_BITS_PER_BYTE 10
+
+//! there is no event
+#define Y_LINK_SIM_NEVER UINT64_MAX
+
+/*!
+ * \brief One end of simulated link
+ * \member protocol_ - context of protocol
+ * \member sim_ - simulation
+ * \member peer_ - other end of link
+ * \member payload_ - buffer for sending payload
+ * \member tx_enabled_ - transmit interrupt is enabled
+ * \member tx_busy_ - byte is on the wire
+ * \member tx_byte_ - byte on the wire
+ * \member tx_arrival_ - time of arrival of byte on the wire
+ * \member tx_free_ - time when next byte can be transmitted
+ * \member rx_byte_ - recieved byte for read byte functor
+ * \member timer_running_ - timer is started
+ * \member timer_in_interrupt_ - YProtocolTimerInterrupt() is being called
+ * \member timer_next_ - time of next timer interrupt
+ * \member next_frame_ - time of sending next packet
+ * \member tx_seq_ - sequence number of next sent packet
+ * \member rx_seq_ - sequence number of next expected packet
+ */
+struct YLinkSimEnd
+{
+	struct YProtocol protocol_;
+	struct YLinkSim *sim_;
+	struct YLinkSimEnd *peer_;
+	uint8_t *payload_;
+	YBOOL tx_enabled_;
+	YBOOL tx_busy_;
+	uint8_t tx_byte_;
+	uint64_t tx_arrival_;
+	uint64_t tx_free_;
+	uint8_t rx_byte_;
+	YBOOL timer_running_;
+	YBOOL timer_in_interrupt_;
+	uint64_t timer_next_;
+	uint64_t next_frame_;
+	uint32_t tx_seq_;
+	uint32_t rx_seq_;
+};
+
+/*!
+ * \brief Simulation
+ * \member config_ - configuration
+ * \member report_ - report
+ * \member ends_ - ends of link
+ * \member now_ - simulated time, ns
+ * \member byte_time_ - time of byte on the wire, ns
+ * \member random_ - state of pseudo random generator
+ * \member latency_sum_ - sum of latencies of delivered packets
+ * \member received_bytes_ - bytes of payload of delivered packets
+ */
+struct YLinkSim
+{
+	const struct YLinkSimConfig *config_;
+	struct YLinkSimReport *report_;
+	struct YLinkSimEnd ends_[2];
+	uint64_t now_;
+	uint64_t byte_time_;
+	uint32_t random_;
+	uint64_t latency_sum_;
+	uint64_t received_bytes_;
+};
+
+uint32_t YLinkSimRandom(struct YLinkSim *sim)
+{
+	// xorshift32
+	sim->random_ ^= sim->random_ << 13;
+	sim->random_ ^= sim->random_ >> 17;
+	sim->random_ ^= sim->random_ << 5;
+	return sim->random_;
+}
+
+YBOOL YLinkSimChance(struct YLinkSim *sim, uint32_t ppm)
+{
+	if (ppm == 0)
+	{
+		return YFALSE;
+	}
+	return (YLinkSimRandom(sim) % 1000000 < ppm) ? YTRUE : YFALSE;
+}
+
+uint8_t YLinkSimPatternByte(uint32_t seq, uint32_t index)
+{
+	return (uint8_t) (seq * 31 + index * 7);
+}
+
+void YLinkSimPutUint32(uint8_t *data, uint32_t value)
+{
+	data[0] = (uint8_t) value;
+	data[1] = (uint8_t) (value >> 8);
+	data[2] = (uint8_t) (value >> 16);
+	data[3] = (uint8_t) (value >> 24);
+}
+
+uint32_t YLinkSimGetUint32(const uint8_t *data)
+{
+	return (uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+uint8_t YLinkSimReadByte(struct YProtocol *protocol)
+{
+	struct YLinkSimEnd *end = (struct YLinkSimEnd*) YProtocolUserData(protocol);
+	
+	return end->rx_byte_;
+}
+
+void YLinkSimSendByte(struct YProtocol *protocol, uint8_t byte)
+{
+	struct YLinkSimEnd *end = (struct YLinkSimEnd*) YProtocolUserData(protocol);
+	struct YLinkSim *sim = end->sim_;
+	
+	end->tx_busy_ = YTRUE;
+	end->tx_byte_ = byte;
+	end->tx_arrival_ = sim->now_ + sim->byte_time_;
+	end->tx_free_ = end->tx_arrival_;
+	if (sim->config_->gap_max_ != 0)
+	{
+		end->tx_free_ += YLinkSimRandom(sim) % (sim->config_->gap_max_ + 1);
+	}
+}
+
+void YLinkSimEnableDisableTransmit(struct YProtocol *protocol, YBOOL enabled)
+{
+	struct YLinkSimEnd *end = (struct YLinkSimEnd*) YProtocolUserData(protocol);
+	
+	end->tx_enabled_ = enabled;
+}
+
+void YLinkSimStartTimer(struct YProtocol *protocol)
+{
+	struct YLinkSimEnd *end = (struct YLinkSimEnd*) YProtocolUserData(protocol);
+	
+	end->timer_running_ = YTRUE;
+	end->timer_next_ = end->sim_->now_ + end->sim_->config_->timer_period_;
+}
+
+void YLinkSimStopTimer(struct YProtocol *protocol)
+{
+	struct YLinkSimEnd *end = (struct YLinkSimEnd*) YProtocolUserData(protocol);
+	
+	// Timer is stopped in timer interrupt only if packet is discarded
+	if (end->timer_in_interrupt_ == YTRUE)
+	{
+		end->sim_->report_->timeouts_++;
+	}
+	end->timer_running_ = YFALSE;
+}
+
+int32_t YLinkSimProcessPacket(struct YProtocol *protocol)
+{
+	struct YLinkSimEnd *end = (struct YLinkSimEnd*) YProtocolUserData(protocol);
+	struct YLinkSim *sim = end->sim_;
+	uint8_t *data = YProtocolParsedData(protocol);
+	uint32_t size = YProtocolParsedDataSize(protocol);
+	uint32_t seq;
+	uint32_t latency;
+	uint32_t i;
+	
+	if (YProtocolFunctionCode(protocol) != Y_LINK_SIM_FC || size != sim->config_->payload_size_)
+	{
+		sim->report_->corrupted_frames_++;
+		return Y_PARSE_IS_OK;
+	}
+	
+	seq = YLinkSimGetUint32(data);
+	for (i = 8; i < size; ++i)
+	{
+		if (data[i] != YLinkSimPatternByte(seq, i))
+		{
+			break;
+		}
+	}
+	// Packets are delivered in order, so sequence number can't go back
+	if (i != size || seq < end->rx_seq_ || seq >= end->peer_->tx_seq_)
+	{
+		sim->report_->corrupted_frames_++;
+		return Y_PARSE_IS_OK;
+	}
+	end->rx_seq_ = seq + 1;
+	
+	latency = (uint32_t) sim->now_ - YLinkSimGetUint32(&data[4]);
+	if (latency > sim->report_->worst_latency_)
+	{
+		sim->report_->worst_latency_ = latency;
+	}
+	sim->latency_sum_ += latency;
+	sim->received_bytes_ += size;
+	sim->report_->received_frames_++;
+	return Y_PARSE_IS_OK;
+}
+
+void YLinkSimSendFrame(struct YLinkSimEnd *end)
+{
+	struct YLinkSim *sim = end->sim_;
+	uint32_t size = sim->config_->payload_size_;
+	uint32_t i;
+	
+	YLinkSimPutUint32(end->payload_, end->tx_seq_);
+	YLinkSimPutUint32(&end->payload_[4], (uint32_t) sim->now_);
+	for (i = 8; i < size; ++i)
+	{
+		end->payload_[i] = YLinkSimPatternByte(end->tx_seq_, i);
+	}
+	
+	if (YProtocolSendPacket(&end->protocol_, Y_LINK_SIM_FC, end->payload_, size) == Y_PARSE_IS_OK)
+	{
+		end->tx_seq_++;
+		sim->report_->sent_frames_++;
+	}
+	else
+	{
+		sim->report_->rejected_frames_++;
+	}
+	end->next_frame_ += sim->config_->frame_period_;
+}
+
+void YLinkSimDeliver(struct YLinkSimEnd *end)
+{
+	struct YLinkSim *sim = end->sim_;
+	struct YLinkSimEnd *peer = end->peer_;
+	uint8_t byte = end->tx_byte_;
+	uint32_t bit;
+	
+	end->tx_busy_ = YFALSE;
+	
+	if (YLinkSimChance(sim, sim->config_->drop_ppm_) == YTRUE)
+	{
+		sim->report_->dropped_bytes_++;
+		return;
+	}
+	for (bit = 0; bit < 8; ++bit)
+	{
+		if (YLinkSimChance(sim, sim->config_->bit_error_ppm_) == YTRUE)
+		{
+			byte ^= (uint8_t) (1 << bit);
+			sim->report_->flipped_bits_++;
+		}
+	}
+	
+	peer->rx_byte_ = byte;
+	if (YProtocolInterrupt(&peer->protocol_, YTRUE) == Y_PARSE_FIFO_FULL)
+	{
+		sim->report_->overflows_++;
+	}
+}
+
+uint64_t YLinkSimNextEvent(struct YLinkSim *sim)
+{
+	uint64_t next = Y_LINK_SIM_NEVER;
+	struct YLinkSimEnd *end;
+	uint32_t i;
+	
+	for (i = 0; i < 2; ++i)
+	{
+		end = &sim->ends_[i];
+		if (end->next_frame_ < sim->config_->duration_ && end->next_frame_ < next)
+		{
+			next = end->next_frame_;
+		}
+		if (end->tx_busy_ == YTRUE && end->tx_arrival_ < next)
+		{
+			next = end->tx_arrival_;
+		}
+		if (end->tx_busy_ == YFALSE && end->tx_enabled_ == YTRUE && end->tx_free_ < next)
+		{
+			next = end->tx_free_;
+		}
+		if (end->timer_running_ == YTRUE && end->timer_next_ < next)
+		{
+			next = end->timer_next_;
+		}
+	}
+	if (next != Y_LINK_SIM_NEVER && next < sim->now_)
+	{
+		next = sim->now_;
+	}
+	return next;
+}
+
+void YLinkSimStep(struct YLinkSim *sim)
+{
+	struct YLinkSimEnd *end;
+	uint32_t i;
+	
+	for (i = 0; i < 2; ++i)
+	{
+		end = &sim->ends_[i];
+	
+		if (end->tx_busy_ == YTRUE && end->tx_arrival_ <= sim->now_)
+		{
+			YLinkSimDeliver(end);
+		}
+		if (end->timer_running_ == YTRUE && end->timer_next_ <= sim->now_)
+		{
+			end->timer_next_ += sim->config_->timer_period_;
+			end->timer_in_interrupt_ = YTRUE;
+			YProtocolTimerInterrupt(&end->protocol_);
+			end->timer_in_interrupt_ = YFALSE;
+		}
+		if (end->next_frame_ < sim->config_->duration_ && end->next_frame_ <= sim->now_)
+		{
+			YLinkSimSendFrame(end);
+		}
+		if (end->tx_busy_ == YFALSE && end->tx_enabled_ == YTRUE && end->tx_free_ <= sim->now_)
+		{
+			YProtocolInterrupt(&end->protocol_, YFALSE);
+		}
+	}
+	
+	// Threads are fast enough to process all recieved bytes between events
+	for (i = 0; i < 2; ++i)
+	{
+		while (YProtocolThread(&sim->ends_[i].protocol_) != Y_PARSE_FIFO_EMPTY)
+		{
+		}
+	}
+}
+
+void YLinkSimInitEnd(struct YLinkSim *sim, uint32_t index)
+{
+	const struct YLinkSimConfig *config = sim->config_;
+	struct YLinkSimEnd *end = &sim->ends_[index];
+	
+	end->sim_ = sim;
+	end->peer_ = &sim->ends_[index ^ 1];
+	end->payload_ = (uint8_t*) malloc(config->payload_size_);
+	// Ends don't send packets simultaneously
+	end->next_frame_ = index * (config->frame_period_ / 2);
+	
+	YProtocolInit(&end->protocol_, config->buffers_size_, YLinkSimReadByte, YLinkSimSendByte,
+		YLinkSimProcessPacket, YLinkSimEnableDisableTransmit);
+	YProtocolSetUserData(&end->protocol_, end);
+	YProtocolSetFraming(&end->protocol_, config->framing_);
+	if (config->timer_period_ != 0)
+	{
+		YProtocolEnableTimer(&end->protocol_, config->timer_ticks_, YLinkSimStartTimer, YLinkSimStopTimer);
+	}
+}
+
+void YLinkSimFreeEnd(struct YLinkSimEnd *end)
+{
+	YProtocolDeinit(&end->protocol_);
+	free(end->payload_);
+}
+
+void YLinkSimDefaultConfig(struct YLinkSimConfig *config)
+{
+	memset(config, 0, sizeof(*config));
+	config->baud_ = 115200;
+	config->buffers_size_ = 256;
+	config->framing_ = Y_PROTOCOL_FRAMING_LENGTH;
+	config->frame_period_ = 5000000;
+	config->payload_size_ = 32;
+	config->duration_ = 1000000000;
+	config->seed_ = 1;
+}
+
+void YLinkSimRun(const struct YLinkSimConfig *config, struct YLinkSimReport *report)
+{
+	struct YLinkSim sim;
+	uint64_t next;
+	
+	memset(&sim, 0, sizeof(sim));
+	memset(report, 0, sizeof(*report));
+	if (config->baud_ == 0 || config->frame_period_ == 0 || config->payload_size_ < 8)
+	{
+		return;
+	}
+	
+	sim.config_ = config;
+	sim.report_ = report;
+	sim.byte_time_ = (uint64_t) Y_LINK_SIM_BITS_PER_BYTE * 1000000000 / config->baud_;
+	sim.random_ = (config->seed_ != 0) ? config->seed_ : 1;
+	YLinkSimInitEnd(&sim, 0);
+	YLinkSimInitEnd(&sim, 1);
+	
+	// Simulation ends when packets aren't sent, wire is idle and timers are stopped
+	while ((next = YLinkSimNextEvent(&sim)) != Y_LINK_SIM_NEVER)
+	{
+		sim.now_ = next;
+		YLinkSimStep(&sim);
+	}
+	
+	report->lost_frames_ = report->sent_frames_ - report->received_frames_;
+	report->elapsed_ = sim.now_;
+	if (sim.now_ != 0)
+	{
+		report->goodput_ = (uint32_t) (sim.received_bytes_ * 1000000000 / sim.now_);
+	}
+	if (report->received_frames_ != 0)
+	{
+		report->average_latency_ = (uint32_t) (sim.latency_sum_ / report->received_frames_);
+	}
+	
+	YLinkSimFreeEnd(&sim.ends_[0]);
+	YLinkSimFreeEnd(&sim.ends_[1]);
+}
+
+void YLinkSimSweep(const struct YLinkSimConfig *configs, struct YLinkSimReport *reports, uint32_t count)
+{
+	uint32_t i;
+	
+	for (i = 0; i < count; ++i)
+	{
+		YLinkSimRun(&configs[i], &reports[i]);
+	}
+}
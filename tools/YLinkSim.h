@@ -0,0 +1,105 @@
+#ifndef __YLINKSIM_H_
+#define __YLINKSIM_H_
+
+#include "YBool.h"
+#include "YProtocol.h"
+
+#include <stdint.h>
+
+/*!
+ * \brief Deterministic simulation of UART link between two protocol contexts on host, it is part of host tools
+ * (see Makefile), not of library, and must be built with YPROTOCOL_HOST.
+ * Both ends send packets to each other every frame_period_, bytes go over the wire with baud rate of link,
+ * random gaps between bytes, bit flips and dropped bytes. YProtocolInterrupt(), YProtocolTimerInterrupt() and
+ * YProtocolThread() are called in simulated time, so equal configurations give equal reports.
+ * Payload of every packet is sequence number (4 bytes), send time (4 bytes) and pattern derived from sequence number.
+ */
+
+/*!
+ * \brief Configuration of simulation
+ * \member baud_ - bits per second, byte is 10 bits on the wire (start bit, 8 data bits, stop bit)
+ * \member gap_max_ - maximum random gap between bytes, ns
+ * \member bit_error_ppm_ - probability of flipping of data bit, parts per million
+ * \member drop_ppm_ - probability of dropping of byte, parts per million
+ * \member buffers_size_ - size of FIFOs of both contexts, see YProtocolInit()
+ * \member framing_ - framing of both contexts, see YProtocolSetFraming()
+ * \member timer_period_ - period of timer interrupt, ns, 0 if timer isn't used
+ * \member timer_ticks_ - ticks of timer for receiving packet, see YProtocolEnableTimer()
+ * \member frame_period_ - period of sending packets by each end, ns
+ * \member payload_size_ - size of payload of packet, at least 8 bytes
+ * \member duration_ - time of sending packets, ns, after it simulation runs while link isn't idle
+ * \member seed_ - seed of pseudo random generator
+ */
+struct YLinkSimConfig
+{
+	uint32_t baud_;
+	uint32_t gap_max_;
+	uint32_t bit_error_ppm_;
+	uint32_t drop_ppm_;
+	uint32_t buffers_size_;
+	uint8_t framing_;
+	uint32_t timer_period_;
+	uint32_t timer_ticks_;
+	uint32_t frame_period_;
+	uint32_t payload_size_;
+	uint64_t duration_;
+	uint32_t seed_;
+};
+
+/*!
+ * \brief Report of simulation, counters are sums of both directions
+ * \member sent_frames_ - packets inserted into outcoming FIFO
+ * \member rejected_frames_ - packets that haven't been inserted completely because outcoming FIFO is full,
+ * beginning of such packet is transmitted and breaks parsing on other end
+ * \member received_frames_ - packets delivered with right payload
+ * \member lost_frames_ - sent packets that haven't been delivered
+ * \member corrupted_frames_ - packets that have passed CRC check with wrong payload
+ * \member flipped_bits_ - bits flipped on the wire
+ * \member dropped_bytes_ - bytes dropped on the wire
+ * \member overflows_ - bytes lost because incoming FIFO is full
+ * \member timeouts_ - packets discarded by timer
+ * \member goodput_ - bytes of payload of delivered packets per second
+ * \member worst_latency_ - maximum time from YProtocolSendPacket() to process packet functor, ns
+ * \member average_latency_ - average time from YProtocolSendPacket() to process packet functor, ns
+ * \member elapsed_ - simulated time, ns
+ */
+struct YLinkSimReport
+{
+	uint32_t sent_frames_;
+	uint32_t rejected_frames_;
+	uint32_t received_frames_;
+	uint32_t lost_frames_;
+	uint32_t corrupted_frames_;
+	uint32_t flipped_bits_;
+	uint32_t dropped_bytes_;
+	uint32_t overflows_;
+	uint32_t timeouts_;
+	uint32_t goodput_;
+	uint32_t worst_latency_;
+	uint32_t average_latency_;
+	uint64_t elapsed_;
+};
+
+/*!
+ * \brief Function fills configuration with defaults: 115200 baud, clean link, length framing,
+ * 256 bytes FIFOs, no timer, 32 bytes packets every 5 ms during 1 s
+ * \param[out] config - configuration of simulation
+ */
+void YLinkSimDefaultConfig(struct YLinkSimConfig *config);
+
+/*!
+ * \brief Function runs simulation
+ * \param[in] config - configuration of simulation
+ * \param[out] report - report of simulation
+ */
+void YLinkSimRun(const struct YLinkSimConfig *config, struct YLinkSimReport *report);
+
+/*!
+ * \brief Function runs simulation for every configuration of sweep
+ * \param[in] configs - configurations of simulation
+ * \param[out] reports - reports, one per configuration
+ * \param[in] count - number of configurations
+ */
+void YLinkSimSweep(const struct YLinkSimConfig *configs, struct YLinkSimReport *reports, uint32_t count);
+
+#endif // __YLINKSIM_H_
@@ -0,0 +1,546 @@
+#include "YProtocol.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+#endif
+
+/*!
+ * \brief Host benchmark of protocol, it must be built with YPROTOCOL_HOST and YPROTOCOL_STATS (see Makefile).
+ * Synthetic corpora are encoded by protocol itself:
+ * - tiny - packets with 1 byte of data
+ * - max - packets of the largest size that fits into buffers
+ * - noisy - packets of random size, some of them have flipped bit or are followed by garbage
+ * Every corpus is recieved in chunks by YProtocolReceive() and parsed by YProtocolThread() in thread and
+ * interrupt parsing modes of both framings until given number of bytes is parsed, then sending of tiny and max
+ * packets is measured. Recorded traffic of device can be benchmarked too: recieved bytes of capture (see YCapture.h)
+ * are corpus "capture", it is parsed in framing of device only. Push and pop of FIFO of bytes are measured alone
+ * in bursts (FIFO is filled completely, then emptied) and interleaved (one push, one pop).
+ * Every run prints one JSON object per line, cycles are TSC cycles on x86, nanoseconds elsewhere.
+ * Parsing runs of noisy corpus follow clean ones and are labelled by scenario (see scenarios below).
+ * Every parsing run reports delivered ratio, handled packets to intact packets (without flipped bit and without
+ * garbage before them), and fails if it is lower than minimum of its scenario, so regressions of resynchronization
+ * are detected. Exit code is number of failed runs.
+ * Usage: ybench [-r capture [-c]] [bytes per run]
+ * -r - benchmark recieved bytes of capture, -c - capture has COBS framing
+ */
+
+//! function code of packets
+#define Y_BENCH_FC 1
+
+//! size of FIFOs
+#define Y_BENCH_BUFFERS_SIZE 256
+
+//! data size of max packets, encoded packet fits into FIFOs in both framings
+#define Y_BENCH_MAX_DATA_SIZE (Y_BENCH_BUFFERS_SIZE - 16)
+
+//! bytes passed to YProtocolReceive() at once, so that interrupt parsing mode doesn't overflow queue of packets
+#define Y_BENCH_CHUNK_SIZE 32
+
+//! minimum size of corpus
+#define Y_BENCH_CORPUS_SIZE 16384
+
+//! default number of bytes per run
+#define Y_BENCH_DEFAULT_BYTES (4 * 1024 * 1024)
+
+//! minimum delivered ratios of noisy corpus, see scenarios, corpus is deterministic and delivers 0.56 and 0.99 now
+#define Y_BENCH_MIN_LENGTH_RESYNC 0.5
+#define Y_BENCH_MIN_COBS_RESYNC 0.95
+
+/*!
+ * \brief Expected delivery of parsing run
+ * \member corpus_ - name of corpus
+ * \member framing_ - framing
+ * \member interrupt_parsing_ - parsing mode
+ * \member scenario_ - label of run
+ * \member min_delivered_ - minimum ratio of handled packets to intact packets
+ */
+struct YBenchScenario
+{
+	const char *corpus_;
+	uint8_t framing_;
+	YBOOL interrupt_parsing_;
+	const char *scenario_;
+	double min_delivered_;
+};
+
+/*!
+ * \brief Scenarios of parsing runs, corpus that isn't listed (capture) has no minimum:
+ * - clean - every packet is delivered
+ * - resync - COBS resynchronizes at delimiter, packet is lost if flipped bit hits delimiter or code byte of its
+ * neighbour. Interrupt parsing of length framing resynchronizes on error of byte counter, but packets
+ * that begin inside skipped bytes are lost
+ * - no_resync - length framing without timer doesn't resynchronize after corrupted byte counter in thread
+ * parsing mode, parser waits for bytes of wrong byte counter, so run measures skipping of bytes and nothing
+ * is expected to be delivered
+ */
+static const struct YBenchScenario scenarios[] =
+{
+	{"tiny", Y_PROTOCOL_FRAMING_LENGTH, YFALSE, "clean", 1.0},
+	{"tiny", Y_PROTOCOL_FRAMING_LENGTH, YTRUE, "clean", 1.0},
+	{"tiny", Y_PROTOCOL_FRAMING_COBS, YFALSE, "clean", 1.0},
+	{"tiny", Y_PROTOCOL_FRAMING_COBS, YTRUE, "clean", 1.0},
+	{"max", Y_PROTOCOL_FRAMING_LENGTH, YFALSE, "clean", 1.0},
+	{"max", Y_PROTOCOL_FRAMING_LENGTH, YTRUE, "clean", 1.0},
+	{"max", Y_PROTOCOL_FRAMING_COBS, YFALSE, "clean", 1.0},
+	{"max", Y_PROTOCOL_FRAMING_COBS, YTRUE, "clean", 1.0},
+	{"noisy", Y_PROTOCOL_FRAMING_LENGTH, YFALSE, "no_resync", 0.0},
+	{"noisy", Y_PROTOCOL_FRAMING_LENGTH, YTRUE, "resync", Y_BENCH_MIN_LENGTH_RESYNC},
+	{"noisy", Y_PROTOCOL_FRAMING_COBS, YFALSE, "resync", Y_BENCH_MIN_COBS_RESYNC},
+	{"noisy", Y_PROTOCOL_FRAMING_COBS, YTRUE, "resync", Y_BENCH_MIN_COBS_RESYNC},
+};
+
+/*!
+ * \brief Corpus of encoded packets
+ * \member name_ - name of corpus
+ * \member data_ - encoded packets
+ * \member size_ - size of data_
+ * \member capacity_ - allocated size of data_
+ * \member frames_ - number of packets
+ * \member intact_ - number of packets without flipped bit and without garbage before them
+ */
+struct YBenchCorpus
+{
+	const char *name_;
+	uint8_t *data_;
+	uint32_t size_;
+	uint32_t capacity_;
+	uint32_t frames_;
+	uint32_t intact_;
+};
+
+//! packets handled by process packet functor
+static uint32_t handled_frames;
+
+//! bytes transmitted by send byte functor
+static uint64_t sent_bytes;
+
+//! state of pseudo random generator
+static uint32_t random_state = 2463534242u;
+
+uint32_t YBenchRandom(void)
+{
+	// xorshift32
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
+uint64_t YBenchCycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+double YBenchSeconds(void)
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+uint8_t YBenchReadByte(struct YProtocol *protocol)
+{
+	return 0;
+}
+
+void YBenchSendByte(struct YProtocol *protocol, uint8_t byte)
+{
+	struct YBenchCorpus *corpus = (struct YBenchCorpus*) YProtocolUserData(protocol);
+	
+	sent_bytes++;
+	if (corpus != NULL)
+	{
+		corpus->data_[corpus->size_++] = byte;
+	}
+}
+
+void YBenchEnableTransmit(struct YProtocol *protocol, YBOOL enabled)
+{
+}
+
+int32_t YBenchProcess(struct YProtocol *protocol)
+{
+	handled_frames++;
+	return Y_PARSE_IS_OK;
+}
+
+void YBenchEncode(struct YProtocol *encoder, uint32_t data_size)
+{
+	uint8_t data[Y_BENCH_MAX_DATA_SIZE];
+	uint32_t i;
+	
+	for (i = 0; i < data_size; ++i)
+	{
+		data[i] = (uint8_t) YBenchRandom();
+	}
+	YProtocolSendPacket(encoder, Y_BENCH_FC, data, data_size);
+	while (YProtocolInterrupt(encoder, YFALSE) == Y_PARSE_IS_OK)
+	{
+	}
+}
+
+void YBenchMakeCorpus(struct YBenchCorpus *corpus, const char *name, uint8_t framing)
+{
+	struct YProtocol encoder;
+	uint32_t begin, i;
+	YBOOL intact, garbage = YFALSE;
+	
+	corpus->name_ = name;
+	corpus->size_ = 0;
+	corpus->capacity_ = Y_BENCH_CORPUS_SIZE + 2 * Y_BENCH_BUFFERS_SIZE;
+	corpus->data_ = (uint8_t*) malloc(corpus->capacity_);
+	corpus->frames_ = 0;
+	corpus->intact_ = 0;
+	YProtocolInit(&encoder, Y_BENCH_BUFFERS_SIZE, YBenchReadByte, YBenchSendByte, YBenchProcess, YBenchEnableTransmit);
+	YProtocolSetFraming(&encoder, framing);
+	YProtocolSetUserData(&encoder, corpus);
+	
+	while (corpus->size_ < Y_BENCH_CORPUS_SIZE)
+	{
+		begin = corpus->size_;
+		intact = (garbage == YTRUE) ? YFALSE : YTRUE;
+		garbage = YFALSE;
+		if (strcmp(name, "tiny") == 0)
+		{
+			YBenchEncode(&encoder, 1);
+		}
+		else if (strcmp(name, "max") == 0)
+		{
+			YBenchEncode(&encoder, Y_BENCH_MAX_DATA_SIZE);
+		}
+		else
+		{
+			YBenchEncode(&encoder, 1 + YBenchRandom() % 64);
+			// Every 8th packet has flipped bit, every 4th packet is followed by garbage
+			if (YBenchRandom() % 8 == 0)
+			{
+				corpus->data_[begin + YBenchRandom() % (corpus->size_ - begin)] ^= (uint8_t) (1 << (YBenchRandom() % 8));
+				intact = YFALSE;
+			}
+			if (YBenchRandom() % 4 == 0)
+			{
+				for (i = YBenchRandom() % 8 + 1; i > 0; --i)
+				{
+					corpus->data_[corpus->size_++] = (uint8_t) YBenchRandom();
+				}
+				garbage = YTRUE;
+			}
+		}
+		corpus->frames_++;
+		if (intact == YTRUE)
+		{
+			corpus->intact_++;
+		}
+	}
+	
+	YProtocolSetUserData(&encoder, NULL);
+	YProtocolDeinit(&encoder);
+}
+
+void YBenchCaptureRecord(void *user_data, uint64_t timestamp, YBOOL is_recieved, uint8_t byte)
+{
+	struct YBenchCorpus *corpus = (struct YBenchCorpus*) user_data;
+	
+	if (is_recieved == YTRUE)
+	{
+		corpus->data_[corpus->size_++] = byte;
+	}
+}
+
+int YBenchLoadCorpus(struct YBenchCorpus *corpus, const char *path)
+{
+	FILE *file;
+	uint8_t *log;
+	long size;
+	uint32_t err;
+	
+	file = fopen(path, "rb");
+	if (file == NULL)
+	{
+		perror(path);
+		return -1;
+	}
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	log = (uint8_t*) malloc((size > 0) ? (size_t) size : 1);
+	if (size <= 0 || fread(log, (size_t) size, 1, file) != 1)
+	{
+		fprintf(stderr, "%s: can't read capture\n", path);
+		free(log);
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+	
+	// Every record takes 2 bytes of log at least, so recieved bytes fit into size of log
+	corpus->name_ = "capture";
+	corpus->size_ = 0;
+	corpus->capacity_ = (uint32_t) size;
+	corpus->data_ = (uint8_t*) malloc(corpus->capacity_);
+	corpus->frames_ = 0;
+	err = YCaptureReplay(log, (uint32_t) size, YBenchCaptureRecord, corpus);
+	free(log);
+	if (err != Y_CAPTURE_NO_ERROR || corpus->size_ == 0)
+	{
+		fprintf(stderr, "%s: %s\n", path, (err == Y_CAPTURE_HEADER_ERROR) ? "wrong header of capture" :
+			(err != Y_CAPTURE_NO_ERROR) ? "capture is truncated" : "no recieved bytes");
+		free(corpus->data_);
+		return -1;
+	}
+	return 0;
+}
+
+const struct YBenchScenario* YBenchFindScenario(const char *corpus, uint8_t framing, YBOOL interrupt_parsing)
+{
+	uint32_t i;
+	
+	for (i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); ++i)
+	{
+		if (strcmp(scenarios[i].corpus_, corpus) == 0 && scenarios[i].framing_ == framing &&
+			scenarios[i].interrupt_parsing_ == interrupt_parsing)
+		{
+			return &scenarios[i];
+		}
+	}
+	return NULL;
+}
+
+void YBenchPrint(const char *bench, const char *corpus, uint8_t framing, const char *mode, uint32_t frames,
+	uint64_t bytes, double seconds, uint64_t cycles, const struct YProtocolStats *stats)
+{
+	printf("{\"bench\":\"%s\",\"corpus\":\"%s\",\"framing\":\"%s\",\"mode\":\"%s\","
+		"\"frames\":%u,\"bytes\":%llu,\"seconds\":%.6f,\"frames_per_s\":%.0f,\"bytes_per_s\":%.0f,"
+		"\"cycles_per_byte\":%.2f,\"allocations\":%u,\"error_bc\":%u,\"error_crc\":%u,\"error_cobs\":%u,"
+		"\"error_frame_queue_full\":%u,\"error_fifo_full\":%u",
+		bench, corpus, (framing == Y_PROTOCOL_FRAMING_COBS) ? "cobs" : "length", mode,
+		frames, (unsigned long long) bytes, seconds, frames / seconds, bytes / seconds,
+		(double) cycles / (double) bytes, stats->allocations_, stats->error_bc_, stats->error_crc_, stats->error_cobs_,
+		stats->error_frame_queue_full_, stats->error_fifo_full_);
+}
+
+uint32_t YBenchParse(const struct YBenchCorpus *corpus, uint8_t framing, YBOOL interrupt_parsing, uint64_t bytes)
+{
+	const struct YBenchScenario *scenario = YBenchFindScenario(corpus->name_, framing, interrupt_parsing);
+	struct YProtocol protocol;
+	struct YProtocolStats stats;
+	uint64_t parsed = 0;
+	uint64_t cycles;
+	double seconds, delivered = 0;
+	uint32_t offset, chunk, passes = 0;
+	YBOOL passed;
+	
+	YProtocolInit(&protocol, Y_BENCH_BUFFERS_SIZE, YBenchReadByte, YBenchSendByte, YBenchProcess, YBenchEnableTransmit);
+	YProtocolSetFraming(&protocol, framing);
+	YProtocolEnableInterruptParsing(&protocol, interrupt_parsing);
+	YProtocolResetStats(&protocol);
+	handled_frames = 0;
+	
+	seconds = YBenchSeconds();
+	cycles = YBenchCycles();
+	while (parsed < bytes)
+	{
+		for (offset = 0; offset < corpus->size_; offset += chunk)
+		{
+			chunk = corpus->size_ - offset;
+			if (chunk > Y_BENCH_CHUNK_SIZE)
+			{
+				chunk = Y_BENCH_CHUNK_SIZE;
+			}
+			YProtocolReceive(&protocol, &corpus->data_[offset], chunk);
+			while (YProtocolThread(&protocol) != Y_PARSE_FIFO_EMPTY)
+			{
+			}
+		}
+		parsed += corpus->size_;
+		passes++;
+	}
+	cycles = YBenchCycles() - cycles;
+	seconds = YBenchSeconds() - seconds;
+	
+	// Corpus is parsed whole number of times, so every pass should deliver its intact packets
+	if (corpus->intact_ != 0)
+	{
+		delivered = (double) handled_frames / ((double) corpus->intact_ * passes);
+	}
+	passed = (scenario == NULL || delivered >= scenario->min_delivered_) ? YTRUE : YFALSE;
+	
+	YProtocolGetStats(&protocol, &stats);
+	YBenchPrint("parse", corpus->name_, framing, (interrupt_parsing == YTRUE) ? "interrupt" : "thread",
+		handled_frames, parsed, seconds, cycles, &stats);
+	if (scenario != NULL)
+	{
+		printf(",\"scenario\":\"%s\",\"intact_frames\":%llu,\"delivered\":%.4f,\"min_delivered\":%.4f,",
+			scenario->scenario_, (unsigned long long) corpus->intact_ * passes, delivered, scenario->min_delivered_);
+	}
+	else
+	{
+		printf(",\"scenario\":null,\"intact_frames\":null,\"delivered\":null,\"min_delivered\":null,");
+	}
+	printf("\"passed\":%s}\n", (passed == YTRUE) ? "true" : "false");
+	YProtocolDeinit(&protocol);
+	return (passed == YTRUE) ? 0 : 1;
+}
+
+void YBenchSend(const char *name, uint32_t data_size, uint8_t framing, uint64_t bytes)
+{
+	struct YProtocol protocol;
+	struct YProtocolStats stats;
+	uint8_t data[Y_BENCH_MAX_DATA_SIZE];
+	uint32_t frames = 0;
+	uint64_t cycles;
+	double seconds;
+	
+	memset(data, 0x55, sizeof(data));
+	YProtocolInit(&protocol, Y_BENCH_BUFFERS_SIZE, YBenchReadByte, YBenchSendByte, YBenchProcess, YBenchEnableTransmit);
+	YProtocolSetFraming(&protocol, framing);
+	YProtocolResetStats(&protocol);
+	sent_bytes = 0;
+	
+	seconds = YBenchSeconds();
+	cycles = YBenchCycles();
+	while (sent_bytes < bytes)
+	{
+		YProtocolSendPacket(&protocol, Y_BENCH_FC, data, data_size);
+		while (YProtocolInterrupt(&protocol, YFALSE) == Y_PARSE_IS_OK)
+		{
+		}
+		frames++;
+	}
+	cycles = YBenchCycles() - cycles;
+	seconds = YBenchSeconds() - seconds;
+	
+	YProtocolGetStats(&protocol, &stats);
+	YBenchPrint("send", name, framing, "thread", frames, sent_bytes, seconds, cycles, &stats);
+	printf("}\n");
+	YProtocolDeinit(&protocol);
+}
+
+void YBenchFifo(YBOOL interleaved, uint64_t bytes)
+{
+	static uint8_t buffer[Y_BENCH_BUFFERS_SIZE];
+	struct YFifo fifo;
+	struct YProtocolStats stats;
+	volatile uint8_t sink = 0;
+	uint64_t moved = 0;
+	uint64_t cycles;
+	double seconds;
+	uint8_t value = 0;
+	
+	fifo.buf_ptr_ = buffer;
+	fifo.size_ = Y_BENCH_BUFFERS_SIZE;
+	YFifo8Flush(&fifo);
+	memset(&stats, 0, sizeof(stats));
+	
+	seconds = YBenchSeconds();
+	cycles = YBenchCycles();
+	while (moved < bytes)
+	{
+		if (interleaved == YTRUE)
+		{
+			YFifo8Push(&fifo, value++);
+			YFifo8Pop(&fifo, &value);
+			sink ^= value;
+			moved++;
+		}
+		else
+		{
+			while (YFifo8Push(&fifo, value++) == Y_FIFO8_NO_ERROR)
+			{
+			}
+			while (YFifo8Pop(&fifo, &value) == Y_FIFO8_NO_ERROR)
+			{
+				sink ^= value;
+				moved++;
+			}
+		}
+	}
+	cycles = YBenchCycles() - cycles;
+	seconds = YBenchSeconds() - seconds;
+	
+	YBenchPrint("fifo", "push_pop", Y_PROTOCOL_FRAMING_LENGTH, (interleaved == YTRUE) ? "interleaved" : "burst",
+		0, moved, seconds, cycles, &stats);
+	printf("}\n");
+}
+
+int main(int argc, char **argv)
+{
+	static struct YBenchCorpus corpus;
+	static const char *names[] = {"tiny", "max"};
+	uint64_t bytes = Y_BENCH_DEFAULT_BYTES;
+	const char *capture = NULL;
+	uint8_t capture_framing = Y_PROTOCOL_FRAMING_LENGTH;
+	uint8_t framing;
+	uint32_t i, failed = 0;
+	int option;
+	
+	while ((option = getopt(argc, argv, "r:c")) != -1)
+	{
+		switch (option)
+		{
+			case 'r':
+				capture = optarg;
+				break;
+			case 'c':
+				capture_framing = Y_PROTOCOL_FRAMING_COBS;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-r capture [-c]] [bytes per run]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (optind < argc)
+	{
+		bytes = strtoull(argv[optind], NULL, 0);
+	}
+	
+	if (capture != NULL)
+	{
+		if (YBenchLoadCorpus(&corpus, capture) != 0)
+		{
+			return 1;
+		}
+		failed += YBenchParse(&corpus, capture_framing, YFALSE, bytes);
+		failed += YBenchParse(&corpus, capture_framing, YTRUE, bytes);
+		free(corpus.data_);
+	}
+	
+	for (framing = Y_PROTOCOL_FRAMING_LENGTH; framing <= Y_PROTOCOL_FRAMING_COBS; ++framing)
+	{
+		for (i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+		{
+			YBenchMakeCorpus(&corpus, names[i], framing);
+			failed += YBenchParse(&corpus, framing, YFALSE, bytes);
+			failed += YBenchParse(&corpus, framing, YTRUE, bytes);
+			free(corpus.data_);
+		}
+		YBenchSend("tiny", 1, framing, bytes);
+		YBenchSend("max", Y_BENCH_MAX_DATA_SIZE, framing, bytes);
+	}
+	
+	// Noisy corpus measures resynchronization after errors, its runs are separate from clean ones
+	for (framing = Y_PROTOCOL_FRAMING_LENGTH; framing <= Y_PROTOCOL_FRAMING_COBS; ++framing)
+	{
+		YBenchMakeCorpus(&corpus, "noisy", framing);
+		failed += YBenchParse(&corpus, framing, YFALSE, bytes);
+		failed += YBenchParse(&corpus, framing, YTRUE, bytes);
+		free(corpus.data_);
+	}
+	
+	YBenchFifo(YFALSE, bytes);
+	YBenchFifo(YTRUE, bytes);
+	return (int) failed;
+}
@@ -0,0 +1,327 @@
+#include "YProtocol.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*!
+ * \brief Regression test of DMA receiving and transmitting with simulated DMA engines on host.
+ * Sender transmits packets by DMA, transmitted bytes are written by recieving DMA engine into circular buffer
+ * of reciever, which calls YProtocolDmaReceiveInterrupt() in half-transfer and transfer-complete interrupts
+ * and, if test wants it, in idle-line interrupt. Every test runs in both framings and both parsing modes:
+ * - half_transfer - long stream without idle-line interrupts, only half-transfer and transfer-complete ones
+ * - idle_line - every packet is delivered by idle-line interrupt right after its last byte
+ * - overrun - reciever's thread doesn't run and interrupts are masked while DMA writes more than free space
+ * of buffer, bytes are dropped with Y_PARSE_FIFO_FULL and the following packets are delivered. In interrupt
+ * parsing mode buffer never keeps bytes, so packets are dropped with Y_PARSE_FRAME_QUEUE_FULL instead
+ * Usage: ydmatest, exit code is number of failed tests
+ */
+
+//! size of buffers of sender
+#define Y_DMA_TEST_TX_SIZE 256
+
+//! size of DMA buffer of reciever, it is small, so stream wraps many times
+#define Y_DMA_TEST_RX_SIZE 64
+
+//! size of payload of packets: sequence number and pattern
+#define Y_DMA_TEST_PAYLOAD_SIZE 12
+
+//! function code of packets
+#define Y_DMA_TEST_FC 5
+
+/*!
+ * \brief Simulated link
+ * \member sender_ - context of sender
+ * \member reciever_ - context of reciever
+ * \member rx_buf_ - DMA buffer of reciever
+ * \member rx_size_ - size of DMA buffer
+ * \member rx_position_ - write position of recieving DMA
+ * \member rx_masked_ - half-transfer and transfer-complete interrupts are masked
+ * \member rx_status_ - Y_PARSE_FIFO_FULL or Y_PARSE_FRAME_QUEUE_FULL if YProtocolDmaReceiveInterrupt() has reported it
+ * \member tx_data_ - bytes of transmission in progress
+ * \member tx_size_ - number of bytes of transmission in progress, 0 if DMA is idle
+ * \member tx_seq_ - sequence number of next sent packet
+ * \member rx_seq_ - sequence number of next expected packet
+ * \member handled_ - packets delivered in order with right payload
+ * \member wrong_ - packets delivered with wrong payload or out of order
+ */
+struct YDmaTest
+{
+	struct YProtocol sender_;
+	struct YProtocol reciever_;
+	uint8_t *rx_buf_;
+	uint32_t rx_size_;
+	uint32_t rx_position_;
+	YBOOL rx_masked_;
+	int32_t rx_status_;
+	uint8_t *tx_data_;
+	uint32_t tx_size_;
+	uint32_t tx_seq_;
+	uint32_t rx_seq_;
+	uint32_t handled_;
+	uint32_t wrong_;
+};
+
+uint8_t YDmaTestReadByte(struct YProtocol *protocol)
+{
+	return 0;
+}
+
+void YDmaTestSendByte(struct YProtocol *protocol, uint8_t byte)
+{
+}
+
+void YDmaTestEnableTransmit(struct YProtocol *protocol, YBOOL enabled)
+{
+}
+
+void YDmaTestStartTransmit(struct YProtocol *protocol, uint8_t *data, uint32_t size)
+{
+	struct YDmaTest *test = (struct YDmaTest*) YProtocolUserData(protocol);
+	
+	test->tx_data_ = data;
+	test->tx_size_ = size;
+}
+
+int32_t YDmaTestProcess(struct YProtocol *protocol)
+{
+	struct YDmaTest *test = (struct YDmaTest*) YProtocolUserData(protocol);
+	const uint8_t *data = YProtocolParsedData(protocol);
+	uint32_t seq, i;
+	
+	if (YProtocolFunctionCode(protocol) != Y_DMA_TEST_FC || YProtocolParsedDataSize(protocol) != Y_DMA_TEST_PAYLOAD_SIZE)
+	{
+		test->wrong_++;
+		return Y_PARSE_IS_OK;
+	}
+	seq = (uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+	for (i = 4; i < Y_DMA_TEST_PAYLOAD_SIZE; ++i)
+	{
+		if (data[i] != (uint8_t) (seq * 13 + i))
+		{
+			test->wrong_++;
+			return Y_PARSE_IS_OK;
+		}
+	}
+	// Packets may be lost only by overrun, but never reordered
+	if (seq < test->rx_seq_)
+	{
+		test->wrong_++;
+		return Y_PARSE_IS_OK;
+	}
+	test->rx_seq_ = seq + 1;
+	test->handled_++;
+	return Y_PARSE_IS_OK;
+}
+
+void YDmaTestInit(struct YDmaTest *test, uint8_t framing, YBOOL interrupt_parsing)
+{
+	memset(test, 0, sizeof(*test));
+	YProtocolInit(&test->sender_, Y_DMA_TEST_TX_SIZE, YDmaTestReadByte, YDmaTestSendByte, YDmaTestProcess,
+		YDmaTestEnableTransmit);
+	YProtocolInit(&test->reciever_, Y_DMA_TEST_RX_SIZE, YDmaTestReadByte, YDmaTestSendByte, YDmaTestProcess,
+		YDmaTestEnableTransmit);
+	YProtocolSetUserData(&test->sender_, test);
+	YProtocolSetUserData(&test->reciever_, test);
+	YProtocolSetFraming(&test->sender_, framing);
+	YProtocolSetFraming(&test->reciever_, framing);
+	YProtocolEnableDmaTransmit(&test->sender_, YDmaTestStartTransmit);
+	test->rx_buf_ = YProtocolEnableDmaReceive(&test->reciever_, &test->rx_size_);
+	YProtocolEnableInterruptParsing(&test->reciever_, interrupt_parsing);
+	test->rx_status_ = Y_PARSE_IS_OK;
+}
+
+void YDmaTestDeinit(struct YDmaTest *test)
+{
+	YProtocolDeinit(&test->sender_);
+	YProtocolDeinit(&test->reciever_);
+}
+
+void YDmaTestReceiveInterrupt(struct YDmaTest *test, uint32_t position)
+{
+	int32_t err = YProtocolDmaReceiveInterrupt(&test->reciever_, position);
+	
+	if (err == Y_PARSE_FIFO_FULL || err == Y_PARSE_FRAME_QUEUE_FULL)
+	{
+		test->rx_status_ = err;
+	}
+}
+
+void YDmaTestWriteByte(struct YDmaTest *test, uint8_t byte)
+{
+	// Recieving DMA in circular mode raises half-transfer and transfer-complete interrupts
+	test->rx_buf_[test->rx_position_++] = byte;
+	if (test->rx_position_ == test->rx_size_ / 2 && test->rx_masked_ == YFALSE)
+	{
+		YDmaTestReceiveInterrupt(test, test->rx_position_);
+	}
+	if (test->rx_position_ == test->rx_size_)
+	{
+		if (test->rx_masked_ == YFALSE)
+		{
+			YDmaTestReceiveInterrupt(test, test->rx_position_);
+		}
+		test->rx_position_ = 0;
+	}
+}
+
+void YDmaTestIdleLine(struct YDmaTest *test)
+{
+	YDmaTestReceiveInterrupt(test, test->rx_position_);
+}
+
+void YDmaTestDrain(struct YDmaTest *test)
+{
+	while (YProtocolThread(&test->reciever_) != Y_PARSE_FIFO_EMPTY)
+	{
+	}
+}
+
+void YDmaTestSend(struct YDmaTest *test, YBOOL drain)
+{
+	uint8_t payload[Y_DMA_TEST_PAYLOAD_SIZE];
+	uint8_t *data;
+	uint32_t size, i;
+	
+	payload[0] = (uint8_t) test->tx_seq_;
+	payload[1] = (uint8_t) (test->tx_seq_ >> 8);
+	payload[2] = (uint8_t) (test->tx_seq_ >> 16);
+	payload[3] = (uint8_t) (test->tx_seq_ >> 24);
+	for (i = 4; i < Y_DMA_TEST_PAYLOAD_SIZE; ++i)
+	{
+		payload[i] = (uint8_t) (test->tx_seq_ * 13 + i);
+	}
+	test->tx_seq_++;
+	YProtocolSendPacket(&test->sender_, Y_DMA_TEST_FC, payload, Y_DMA_TEST_PAYLOAD_SIZE);
+	
+	// Transmitting DMA completes transfers, transfer-complete interrupt starts the next part of FIFO
+	while (test->tx_size_ != 0)
+	{
+		data = test->tx_data_;
+		size = test->tx_size_;
+		test->tx_size_ = 0;
+		for (i = 0; i < size; ++i)
+		{
+			YDmaTestWriteByte(test, data[i]);
+			if (drain == YTRUE)
+			{
+				YDmaTestDrain(test);
+			}
+		}
+		YProtocolDmaTransmitInterrupt(&test->sender_);
+	}
+}
+
+uint32_t YDmaTestHalfTransfer(struct YDmaTest *test, YBOOL interrupt_parsing)
+{
+	uint32_t i;
+	
+	// Packets aren't aligned to halves of buffer, so every packet is split between interrupts
+	for (i = 0; i < 200; ++i)
+	{
+		YDmaTestSend(test, YTRUE);
+	}
+	YDmaTestIdleLine(test);
+	YDmaTestDrain(test);
+	return test->handled_ == 200 && test->wrong_ == 0 && test->rx_status_ == Y_PARSE_IS_OK;
+}
+
+uint32_t YDmaTestIdleLineDelivery(struct YDmaTest *test, YBOOL interrupt_parsing)
+{
+	uint32_t i;
+	
+	for (i = 0; i < 50; ++i)
+	{
+		YDmaTestSend(test, YFALSE);
+		YDmaTestIdleLine(test);
+		YDmaTestDrain(test);
+		if (test->handled_ != i + 1)
+		{
+			return 0;
+		}
+	}
+	return test->wrong_ == 0 && test->rx_status_ == Y_PARSE_IS_OK;
+}
+
+uint32_t YDmaTestOverrun(struct YDmaTest *test, YBOOL interrupt_parsing)
+{
+	uint32_t i, handled;
+	
+	for (i = 0; i < 5; ++i)
+	{
+		YDmaTestSend(test, YTRUE);
+	}
+	YDmaTestIdleLine(test);
+	YDmaTestDrain(test);
+	
+	// Thread doesn't run, 2 packets are kept in buffer
+	for (i = 0; i < 2; ++i)
+	{
+		YDmaTestSend(test, YFALSE);
+	}
+	if (interrupt_parsing == YTRUE)
+	{
+		// Queue of parsed packets overflows
+		for (i = 0; i < 2 * YPROTOCOL_FRAME_QUEUE_SIZE; ++i)
+		{
+			YDmaTestSend(test, YFALSE);
+		}
+	}
+	else
+	{
+		// Interrupts are masked while DMA writes 2 packets more, so overrun ends at packet boundary
+		test->rx_masked_ = YTRUE;
+		for (i = 0; i < 2; ++i)
+		{
+			YDmaTestSend(test, YFALSE);
+		}
+		test->rx_masked_ = YFALSE;
+	}
+	YDmaTestIdleLine(test);
+	if (test->rx_status_ != ((interrupt_parsing == YTRUE) ? Y_PARSE_FRAME_QUEUE_FULL : Y_PARSE_FIFO_FULL))
+	{
+		return 0;
+	}
+	YDmaTestDrain(test);
+	handled = test->handled_;
+	
+	for (i = 0; i < 20; ++i)
+	{
+		YDmaTestSend(test, YTRUE);
+	}
+	YDmaTestIdleLine(test);
+	YDmaTestDrain(test);
+	return handled >= 5 && test->handled_ == handled + 20 && test->wrong_ == 0;
+}
+
+int main(void)
+{
+	static struct YDmaTest test;
+	static const char *names[] = {"half_transfer", "idle_line", "overrun"};
+	uint32_t (*tests[])(struct YDmaTest *test, YBOOL interrupt_parsing) = {YDmaTestHalfTransfer, YDmaTestIdleLineDelivery, YDmaTestOverrun};
+	uint32_t failed = 0;
+	uint32_t i, passed;
+	uint8_t framing;
+	YBOOL interrupt_parsing;
+	
+	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i)
+	{
+		for (framing = Y_PROTOCOL_FRAMING_LENGTH; framing <= Y_PROTOCOL_FRAMING_COBS; ++framing)
+		{
+			for (interrupt_parsing = YFALSE; interrupt_parsing <= YTRUE; ++interrupt_parsing)
+			{
+				YDmaTestInit(&test, framing, interrupt_parsing);
+				passed = tests[i](&test, interrupt_parsing);
+				printf("%s %s %s %s: handled %u wrong %u\n", passed ? "ok" : "FAIL", names[i],
+					(framing == Y_PROTOCOL_FRAMING_COBS) ? "cobs" : "length",
+					(interrupt_parsing == YTRUE) ? "interrupt" : "thread", test.handled_, test.wrong_);
+				if (!passed)
+				{
+					failed++;
+				}
+				YDmaTestDeinit(&test);
+			}
+		}
+	}
+	return (int) failed;
+}
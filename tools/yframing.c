@@ -0,0 +1,82 @@
+#include "YLinkSim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*!
+ * \brief Comparison of framings on simulated link with bit errors (see YLinkSim.h). For every bit error rate
+ * length framing without timer, length framing with timer of 3 byte times and COBS framing are simulated
+ * with equal seed, so they see equal traffic and errors. Result is CSV with header line.
+ * Usage: yframing [seconds [seed]]
+ */
+
+//! bit error rates of sweep, ppm
+static const uint32_t bit_error_ppms[] = {0, 10, 30, 100, 300, 1000, 3000};
+
+//! variants of framing
+#define Y_FRAMING_LENGTH 0
+#define Y_FRAMING_LENGTH_TIMER 1
+#define Y_FRAMING_COBS 2
+#define Y_FRAMING_VARIANTS 3
+
+//! names of variants of framing
+static const char *framing_names[Y_FRAMING_VARIANTS] = {"length", "length_timer", "cobs"};
+
+#define Y_FRAMING_RATES (sizeof(bit_error_ppms) / sizeof(bit_error_ppms[0]))
+
+int main(int argc, char **argv)
+{
+	static struct YLinkSimConfig configs[Y_FRAMING_RATES * Y_FRAMING_VARIANTS];
+	static struct YLinkSimReport reports[Y_FRAMING_RATES * Y_FRAMING_VARIANTS];
+	struct YLinkSimConfig *config;
+	const struct YLinkSimReport *report;
+	uint64_t seconds = 10;
+	uint32_t seed = 1;
+	uint32_t rate, variant, i;
+	
+	if (argc > 1)
+	{
+		seconds = strtoull(argv[1], NULL, 0);
+	}
+	if (argc > 2)
+	{
+		seed = (uint32_t) strtoul(argv[2], NULL, 0);
+	}
+	
+	for (rate = 0; rate < Y_FRAMING_RATES; ++rate)
+	{
+		for (variant = 0; variant < Y_FRAMING_VARIANTS; ++variant)
+		{
+			config = &configs[rate * Y_FRAMING_VARIANTS + variant];
+			YLinkSimDefaultConfig(config);
+			config->bit_error_ppm_ = bit_error_ppms[rate];
+			config->duration_ = seconds * 1000000000;
+			config->seed_ = seed;
+			if (variant == Y_FRAMING_COBS)
+			{
+				config->framing_ = Y_PROTOCOL_FRAMING_COBS;
+			}
+			if (variant == Y_FRAMING_LENGTH_TIMER)
+			{
+				// Timer ticks every byte time, packet is dropped after 3 silent byte times
+				config->timer_period_ = (uint32_t) (10 * 1000000000ull / config->baud_);
+				config->timer_ticks_ = 3;
+			}
+		}
+	}
+	YLinkSimSweep(configs, reports, Y_FRAMING_RATES * Y_FRAMING_VARIANTS);
+	
+	printf("bit_error_ppm,framing,sent_frames,received_frames,lost_frames,corrupted_frames,delivery,"
+		"flipped_bits,timeouts,goodput,average_latency,worst_latency\n");
+	for (i = 0; i < Y_FRAMING_RATES * Y_FRAMING_VARIANTS; ++i)
+	{
+		report = &reports[i];
+		printf("%u,%s,%u,%u,%u,%u,%.4f,%u,%u,%u,%u,%u\n", configs[i].bit_error_ppm_,
+			framing_names[i % Y_FRAMING_VARIANTS], report->sent_frames_, report->received_frames_,
+			report->lost_frames_, report->corrupted_frames_,
+			(report->sent_frames_ != 0) ? (double) report->received_frames_ / report->sent_frames_ : 0.0,
+			report->flipped_bits_, report->timeouts_, report->goodput_, report->average_latency_,
+			report->worst_latency_);
+	}
+	return 0;
+}
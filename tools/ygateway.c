@@ -0,0 +1,488 @@
+#define _GNU_SOURCE
+#include "YProtocol.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*!
+ * \brief Gateway daemon of links on Linux. Every TCP connection (for example serial port bridged to TCP) is link
+ * with its own context of protocol. Links are sharded by core: every worker thread is pinned to one core, has its own
+ * epoll and its own listening socket of the same port (SO_REUSEPORT), so kernel distributes connections between
+ * workers and link is owned by one worker for its whole life, there are no locks between workers.
+ * Bytes are read from socket straight into incoming FIFO (it is used as DMA buffer, see YProtocolEnableDmaReceive())
+ * and parsed in batches, every parsed packet is echoed back with the same function code. Replies are written from
+ * outcoming FIFO by DMA transmit functor (see YProtocolEnableDmaTransmit()), link isn't read while socket doesn't take
+ * its replies. Link reads at most a half of buffers at once, so replies of one batch fit into outcoming FIFO.
+ * Workers and summaries of workers at exit (SIGINT, SIGTERM or end of duration) are printed one JSON object per line.
+ * Usage: ygateway [-w workers] [-p port] [-b buffers_size] [-d seconds] [-c]
+ * -w - number of workers, default is number of cores, -c - COBS framing
+ */
+
+//! default port
+#define Y_GATEWAY_PORT 7777
+
+//! default size of FIFOs of link
+#define Y_GATEWAY_BUFFERS_SIZE 4096
+
+//! events taken from epoll at once
+#define Y_GATEWAY_EVENTS 64
+
+//! reads of one link per event, then other links of worker are served
+#define Y_GATEWAY_READS 8
+
+//! maximum number of workers
+#define Y_GATEWAY_WORKERS 256
+
+struct YGatewayWorker;
+
+/*!
+ * \brief Link
+ * \member protocol_ - context of protocol
+ * \member worker_ - worker that owns link
+ * \member fd_ - socket
+ * \member rx_buf_ - incoming FIFO buffer, bytes are read into it
+ * \member rx_size_ - size of rx_buf_
+ * \member rx_position_ - position of the next read byte in rx_buf_
+ * \member tx_data_ - bytes being written, they are part of outcoming FIFO
+ * \member tx_size_ - size of tx_data_, 0 if nothing is being written
+ * \member tx_done_ - written bytes of tx_data_
+ * \member events_ - events of epoll
+ * \member prev_ - previous link of worker
+ * \member next_ - next link of worker
+ */
+struct YGatewayLink
+{
+	struct YProtocol protocol_;
+	struct YGatewayWorker *worker_;
+	int fd_;
+	uint8_t *rx_buf_;
+	uint32_t rx_size_;
+	uint32_t rx_position_;
+	uint8_t *tx_data_;
+	uint32_t tx_size_;
+	uint32_t tx_done_;
+	uint32_t events_;
+	struct YGatewayLink *prev_;
+	struct YGatewayLink *next_;
+};
+
+/*!
+ * \brief Worker, it is touched only by its thread until it is joined
+ * \member thread_ - thread of worker
+ * \member index_ - index of worker
+ * \member cpu_ - core of worker
+ * \member listen_fd_ - listening socket
+ * \member epoll_fd_ - epoll
+ * \member links_ - list of links
+ * \member accepted_ - number of accepted links
+ * \member frames_ - parsed packets
+ * \member rx_bytes_ - read bytes
+ * \member tx_bytes_ - written bytes
+ * \member dropped_replies_ - replies that haven't fit into outcoming FIFO
+ */
+struct YGatewayWorker
+{
+	pthread_t thread_;
+	uint32_t index_;
+	int cpu_;
+	int listen_fd_;
+	int epoll_fd_;
+	struct YGatewayLink *links_;
+	uint64_t accepted_;
+	uint64_t frames_;
+	uint64_t rx_bytes_;
+	uint64_t tx_bytes_;
+	uint64_t dropped_replies_;
+};
+
+//! framing of links
+static uint8_t framing = Y_PROTOCOL_FRAMING_LENGTH;
+
+//! size of FIFOs of link
+static uint32_t buffers_size = Y_GATEWAY_BUFFERS_SIZE;
+
+//! workers stop when it is set
+static volatile sig_atomic_t stopping;
+
+void YGatewayStop(int signal_number)
+{
+	stopping = 1;
+}
+
+uint8_t YGatewayReadByte(struct YProtocol *protocol)
+{
+	return 0;
+}
+
+void YGatewaySendByte(struct YProtocol *protocol, uint8_t byte)
+{
+}
+
+void YGatewayEnableTransmit(struct YProtocol *protocol, YBOOL enabled)
+{
+}
+
+void YGatewayTransmit(struct YProtocol *protocol, uint8_t *data, uint32_t size)
+{
+	struct YGatewayLink *link = (struct YGatewayLink*) YProtocolUserData(protocol);
+	
+	// Bytes are written by worker after batch of packets is parsed
+	link->tx_data_ = data;
+	link->tx_size_ = size;
+	link->tx_done_ = 0;
+}
+
+int32_t YGatewayProcess(struct YProtocol *protocol)
+{
+	struct YGatewayLink *link = (struct YGatewayLink*) YProtocolUserData(protocol);
+	
+	link->worker_->frames_++;
+	if (YProtocolSendPacket(protocol, YProtocolFunctionCode(protocol), YProtocolParsedData(protocol),
+		YProtocolParsedDataSize(protocol)) != Y_PARSE_IS_OK)
+	{
+		link->worker_->dropped_replies_++;
+	}
+	return Y_PARSE_IS_OK;
+}
+
+int YGatewayListen(uint16_t port)
+{
+	struct sockaddr_in address;
+	int fd, enabled = 1;
+	
+	fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+	if (fd < 0)
+	{
+		return -1;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled)) != 0 ||
+		setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enabled, sizeof(enabled)) != 0 ||
+		bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+void YGatewayOpen(struct YGatewayWorker *worker, int fd)
+{
+	struct YGatewayLink *link;
+	struct epoll_event event;
+	int enabled = 1;
+	
+	link = (struct YGatewayLink*) calloc(1, sizeof(*link));
+	if (link == NULL)
+	{
+		close(fd);
+		return;
+	}
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+	link->worker_ = worker;
+	link->fd_ = fd;
+	YProtocolInit(&link->protocol_, buffers_size, YGatewayReadByte, YGatewaySendByte, YGatewayProcess,
+		YGatewayEnableTransmit);
+	YProtocolSetFraming(&link->protocol_, framing);
+	YProtocolSetUserData(&link->protocol_, link);
+	link->rx_buf_ = YProtocolEnableDmaReceive(&link->protocol_, &link->rx_size_);
+	YProtocolEnableDmaTransmit(&link->protocol_, YGatewayTransmit);
+	
+	link->events_ = EPOLLIN;
+	event.events = link->events_;
+	event.data.ptr = link;
+	if (epoll_ctl(worker->epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0)
+	{
+		YProtocolDeinit(&link->protocol_);
+		free(link);
+		close(fd);
+		return;
+	}
+	link->next_ = worker->links_;
+	if (worker->links_ != NULL)
+	{
+		worker->links_->prev_ = link;
+	}
+	worker->links_ = link;
+	worker->accepted_++;
+}
+
+void YGatewayClose(struct YGatewayLink *link)
+{
+	struct YGatewayWorker *worker = link->worker_;
+	
+	epoll_ctl(worker->epoll_fd_, EPOLL_CTL_DEL, link->fd_, NULL);
+	close(link->fd_);
+	if (link->prev_ != NULL)
+	{
+		link->prev_->next_ = link->next_;
+	}
+	else
+	{
+		worker->links_ = link->next_;
+	}
+	if (link->next_ != NULL)
+	{
+		link->next_->prev_ = link->prev_;
+	}
+	YProtocolDeinit(&link->protocol_);
+	free(link);
+}
+
+int YGatewayFlush(struct YGatewayLink *link)
+{
+	ssize_t written;
+	
+	// Every written part is released by transmit interrupt, it starts the next part of outcoming FIFO
+	while (link->tx_size_ != 0)
+	{
+		written = send(link->fd_, link->tx_data_ + link->tx_done_, link->tx_size_ - link->tx_done_, MSG_NOSIGNAL);
+		if (written < 0)
+		{
+			return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+		}
+		link->tx_done_ += (uint32_t) written;
+		link->worker_->tx_bytes_ += (uint64_t) written;
+		if (link->tx_done_ == link->tx_size_)
+		{
+			link->tx_size_ = 0;
+			YProtocolDmaTransmitInterrupt(&link->protocol_);
+		}
+	}
+	return 0;
+}
+
+int YGatewayRead(struct YGatewayLink *link)
+{
+	uint32_t reads, chunk;
+	ssize_t count;
+	
+	for (reads = 0; reads < Y_GATEWAY_READS && link->tx_size_ == 0; ++reads)
+	{
+		// Incoming FIFO is empty before every read, contiguous part of buffer is filled
+		chunk = link->rx_size_ - link->rx_position_;
+		if (chunk > link->rx_size_ / 2)
+		{
+			chunk = link->rx_size_ / 2;
+		}
+		count = read(link->fd_, link->rx_buf_ + link->rx_position_, chunk);
+		if (count == 0)
+		{
+			return -1;
+		}
+		if (count < 0)
+		{
+			return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+		}
+		link->worker_->rx_bytes_ += (uint64_t) count;
+		link->rx_position_ = (link->rx_position_ + (uint32_t) count) % link->rx_size_;
+		YProtocolDmaReceiveInterrupt(&link->protocol_, link->rx_position_);
+		while (YProtocolThread(&link->protocol_) != Y_PARSE_FIFO_EMPTY)
+		{
+		}
+		if (YGatewayFlush(link) != 0)
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int YGatewayUpdate(struct YGatewayLink *link)
+{
+	struct epoll_event event;
+	uint32_t events = (link->tx_size_ != 0) ? EPOLLOUT : EPOLLIN;
+	
+	// Link isn't read until its replies are written
+	if (events == link->events_)
+	{
+		return 0;
+	}
+	link->events_ = events;
+	event.events = events;
+	event.data.ptr = link;
+	return epoll_ctl(link->worker_->epoll_fd_, EPOLL_CTL_MOD, link->fd_, &event);
+}
+
+void* YGatewayWork(void *argument)
+{
+	struct YGatewayWorker *worker = (struct YGatewayWorker*) argument;
+	struct epoll_event events[Y_GATEWAY_EVENTS];
+	struct YGatewayLink *link;
+	cpu_set_t cpus;
+	int count, i, fd, err;
+	
+	CPU_ZERO(&cpus);
+	CPU_SET(worker->cpu_, &cpus);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	
+	while (stopping == 0)
+	{
+		count = epoll_wait(worker->epoll_fd_, events, Y_GATEWAY_EVENTS, 100);
+		for (i = 0; i < count; ++i)
+		{
+			link = (struct YGatewayLink*) events[i].data.ptr;
+			if (link == NULL)
+			{
+				while ((fd = accept4(worker->listen_fd_, NULL, NULL, SOCK_NONBLOCK)) >= 0)
+				{
+					YGatewayOpen(worker, fd);
+				}
+				continue;
+			}
+			err = 0;
+			if (events[i].events & EPOLLOUT)
+			{
+				err = YGatewayFlush(link);
+			}
+			if (err == 0 && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+			{
+				err = YGatewayRead(link);
+			}
+			if (err == 0)
+			{
+				err = YGatewayUpdate(link);
+			}
+			if (err != 0)
+			{
+				YGatewayClose(link);
+			}
+		}
+	}
+	
+	while (worker->links_ != NULL)
+	{
+		YGatewayClose(worker->links_);
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	static struct YGatewayWorker workers[Y_GATEWAY_WORKERS];
+	struct YGatewayWorker *worker;
+	struct epoll_event event;
+	struct sigaction action;
+	cpu_set_t cpus;
+	uint32_t workers_count = 0;
+	uint32_t seconds = 0;
+	uint32_t i;
+	uint16_t port = Y_GATEWAY_PORT;
+	int option, cpu;
+	uint64_t accepted = 0, frames = 0, rx_bytes = 0, tx_bytes = 0, dropped_replies = 0;
+	
+	while ((option = getopt(argc, argv, "w:p:b:d:c")) != -1)
+	{
+		switch (option)
+		{
+		case 'w':
+			workers_count = (uint32_t) strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			port = (uint16_t) strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			buffers_size = (uint32_t) strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			seconds = (uint32_t) strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			framing = Y_PROTOCOL_FRAMING_COBS;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-w workers] [-p port] [-b buffers_size] [-d seconds] [-c]\n", argv[0]);
+			return 2;
+		}
+	}
+	
+	// Workers are pinned to allowed cores in turn
+	CPU_ZERO(&cpus);
+	sched_getaffinity(0, sizeof(cpus), &cpus);
+	if (workers_count == 0)
+	{
+		workers_count = (uint32_t) CPU_COUNT(&cpus);
+	}
+	if (workers_count > Y_GATEWAY_WORKERS || buffers_size < 16)
+	{
+		fprintf(stderr, "at most %u workers, buffers size at least 16\n", Y_GATEWAY_WORKERS);
+		return 2;
+	}
+	
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = YGatewayStop;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	
+	cpu = -1;
+	for (i = 0; i < workers_count; ++i)
+	{
+		worker = &workers[i];
+		do
+		{
+			cpu = (cpu + 1) % CPU_SETSIZE;
+		}
+		while (!CPU_ISSET(cpu, &cpus));
+		worker->index_ = i;
+		worker->cpu_ = cpu;
+		worker->listen_fd_ = YGatewayListen(port);
+		worker->epoll_fd_ = epoll_create1(0);
+		if (worker->listen_fd_ < 0 || worker->epoll_fd_ < 0)
+		{
+			perror("listen");
+			return 1;
+		}
+		event.events = EPOLLIN;
+		event.data.ptr = NULL;
+		epoll_ctl(worker->epoll_fd_, EPOLL_CTL_ADD, worker->listen_fd_, &event);
+	}
+	for (i = 0; i < workers_count; ++i)
+	{
+		pthread_create(&workers[i].thread_, NULL, YGatewayWork, &workers[i]);
+	}
+	printf("{\"port\":%u,\"workers\":%u,\"framing\":%u,\"buffers_size\":%u}\n", port, workers_count, framing,
+		buffers_size);
+	fflush(stdout);
+	
+	if (seconds != 0)
+	{
+		for (i = 0; i < seconds && stopping == 0; ++i)
+		{
+			sleep(1);
+		}
+		stopping = 1;
+	}
+	for (i = 0; i < workers_count; ++i)
+	{
+		worker = &workers[i];
+		pthread_join(worker->thread_, NULL);
+		close(worker->listen_fd_);
+		close(worker->epoll_fd_);
+		printf("{\"worker\":%u,\"cpu\":%d,\"links\":%llu,\"frames\":%llu,\"rx_bytes\":%llu,\"tx_bytes\":%llu,"
+			"\"dropped_replies\":%llu}\n", worker->index_, worker->cpu_, (unsigned long long) worker->accepted_,
+			(unsigned long long) worker->frames_, (unsigned long long) worker->rx_bytes_,
+			(unsigned long long) worker->tx_bytes_, (unsigned long long) worker->dropped_replies_);
+		accepted += worker->accepted_;
+		frames += worker->frames_;
+		rx_bytes += worker->rx_bytes_;
+		tx_bytes += worker->tx_bytes_;
+		dropped_replies += worker->dropped_replies_;
+	}
+	printf("{\"workers\":%u,\"links\":%llu,\"frames\":%llu,\"rx_bytes\":%llu,\"tx_bytes\":%llu,\"dropped_replies\":%llu}\n",
+		workers_count, (unsigned long long) accepted, (unsigned long long) frames, (unsigned long long) rx_bytes,
+		(unsigned long long) tx_bytes, (unsigned long long) dropped_replies);
+	return 0;
+}
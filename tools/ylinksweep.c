@@ -0,0 +1,225 @@
+#include "YLinkSim.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*!
+ * \brief Sweep of simulated link (see YLinkSim.h). Every argument is parameter of configuration with list of values,
+ * all combinations of values are simulated, other parameters are defaults of YLinkSimDefaultConfig().
+ * Every configuration and its report are printed as one JSON object per line.
+ * Usage: ylinksweep [parameter=value[,value...]]...
+ * Example: ylinksweep framing=0,1 bit_error_ppm=0,100,1000 baud=9600,115200
+ */
+
+//! maximum number of values of parameter
+#define Y_LINK_SWEEP_VALUES 64
+
+//! maximum number of configurations
+#define Y_LINK_SWEEP_CONFIGS 65536
+
+/*!
+ * \brief Parameter of configuration
+ * \member name_ - name of parameter, it is name of member without trailing underscore
+ * \member offset_ - offset of member in configuration
+ * \member size_ - size of member
+ */
+struct YLinkSweepParameter
+{
+	const char *name_;
+	size_t offset_;
+	size_t size_;
+};
+
+#define Y_LINK_SWEEP_PARAMETER(_member) {#_member, offsetof(struct YLinkSimConfig, _member##_), \
+	sizeof(((struct YLinkSimConfig*) 0)->_member##_)}
+
+//! parameters of configuration
+static const struct YLinkSweepParameter parameters[] =
+{
+	Y_LINK_SWEEP_PARAMETER(baud),
+	Y_LINK_SWEEP_PARAMETER(gap_max),
+	Y_LINK_SWEEP_PARAMETER(bit_error_ppm),
+	Y_LINK_SWEEP_PARAMETER(drop_ppm),
+	Y_LINK_SWEEP_PARAMETER(buffers_size),
+	Y_LINK_SWEEP_PARAMETER(framing),
+	Y_LINK_SWEEP_PARAMETER(timer_period),
+	Y_LINK_SWEEP_PARAMETER(timer_ticks),
+	Y_LINK_SWEEP_PARAMETER(frame_period),
+	Y_LINK_SWEEP_PARAMETER(payload_size),
+	Y_LINK_SWEEP_PARAMETER(duration),
+	Y_LINK_SWEEP_PARAMETER(seed),
+};
+
+#define Y_LINK_SWEEP_PARAMETERS (sizeof(parameters) / sizeof(parameters[0]))
+
+/*!
+ * \brief Values of swept parameter
+ * \member parameter_ - parameter
+ * \member values_ - values
+ * \member count_ - number of values
+ */
+struct YLinkSweepAxis
+{
+	const struct YLinkSweepParameter *parameter_;
+	uint64_t values_[Y_LINK_SWEEP_VALUES];
+	uint32_t count_;
+};
+
+void YLinkSweepSet(struct YLinkSimConfig *config, const struct YLinkSweepParameter *parameter, uint64_t value)
+{
+	uint8_t *member = (uint8_t*) config + parameter->offset_;
+	
+	if (parameter->size_ == sizeof(uint8_t))
+	{
+		*member = (uint8_t) value;
+	}
+	else if (parameter->size_ == sizeof(uint32_t))
+	{
+		*(uint32_t*) member = (uint32_t) value;
+	}
+	else
+	{
+		*(uint64_t*) member = value;
+	}
+}
+
+uint64_t YLinkSweepGet(const struct YLinkSimConfig *config, const struct YLinkSweepParameter *parameter)
+{
+	const uint8_t *member = (const uint8_t*) config + parameter->offset_;
+	
+	if (parameter->size_ == sizeof(uint8_t))
+	{
+		return *member;
+	}
+	if (parameter->size_ == sizeof(uint32_t))
+	{
+		return *(const uint32_t*) member;
+	}
+	return *(const uint64_t*) member;
+}
+
+int YLinkSweepParse(const char *argument, struct YLinkSweepAxis *axis)
+{
+	const char *values = strchr(argument, '=');
+	char *end;
+	uint32_t i;
+	
+	if (values == NULL)
+	{
+		return -1;
+	}
+	axis->parameter_ = NULL;
+	for (i = 0; i < Y_LINK_SWEEP_PARAMETERS; ++i)
+	{
+		if (strlen(parameters[i].name_) == (size_t) (values - argument) &&
+			strncmp(parameters[i].name_, argument, (size_t) (values - argument)) == 0)
+		{
+			axis->parameter_ = &parameters[i];
+		}
+	}
+	if (axis->parameter_ == NULL)
+	{
+		return -1;
+	}
+	
+	axis->count_ = 0;
+	do
+	{
+		if (axis->count_ == Y_LINK_SWEEP_VALUES)
+		{
+			return -1;
+		}
+		axis->values_[axis->count_++] = strtoull(values + 1, &end, 0);
+		if (end == values + 1 || (*end != ',' && *end != '\0'))
+		{
+			return -1;
+		}
+		values = end;
+	}
+	while (*values == ',');
+	return 0;
+}
+
+void YLinkSweepPrint(const struct YLinkSimConfig *config, const struct YLinkSimReport *report)
+{
+	uint32_t i;
+	
+	printf("{");
+	for (i = 0; i < Y_LINK_SWEEP_PARAMETERS; ++i)
+	{
+		printf("\"%s\":%llu,", parameters[i].name_, (unsigned long long) YLinkSweepGet(config, &parameters[i]));
+	}
+	printf("\"sent_frames\":%u,\"rejected_frames\":%u,\"received_frames\":%u,\"lost_frames\":%u,"
+		"\"corrupted_frames\":%u,\"flipped_bits\":%u,\"dropped_bytes\":%u,\"overflows\":%u,\"timeouts\":%u,"
+		"\"goodput\":%u,\"worst_latency\":%u,\"average_latency\":%u,\"elapsed\":%llu}\n",
+		report->sent_frames_, report->rejected_frames_, report->received_frames_, report->lost_frames_,
+		report->corrupted_frames_, report->flipped_bits_, report->dropped_bytes_, report->overflows_,
+		report->timeouts_, report->goodput_, report->worst_latency_, report->average_latency_,
+		(unsigned long long) report->elapsed_);
+}
+
+int main(int argc, char **argv)
+{
+	static struct YLinkSweepAxis axes[Y_LINK_SWEEP_PARAMETERS];
+	struct YLinkSimConfig *configs;
+	struct YLinkSimReport *reports;
+	uint32_t count = 1;
+	uint32_t axes_count, i, j, index;
+	
+	if ((uint32_t) argc - 1 > Y_LINK_SWEEP_PARAMETERS)
+	{
+		fprintf(stderr, "too many parameters\n");
+		return 2;
+	}
+	axes_count = (uint32_t) argc - 1;
+	for (i = 0; i < axes_count; ++i)
+	{
+		if (YLinkSweepParse(argv[i + 1], &axes[i]) != 0)
+		{
+			fprintf(stderr, "usage: %s [parameter=value[,value...]]...\nparameters:", argv[0]);
+			for (j = 0; j < Y_LINK_SWEEP_PARAMETERS; ++j)
+			{
+				fprintf(stderr, " %s", parameters[j].name_);
+			}
+			fprintf(stderr, "\n");
+			return 2;
+		}
+		count *= axes[i].count_;
+		if (count > Y_LINK_SWEEP_CONFIGS)
+		{
+			fprintf(stderr, "too many configurations\n");
+			return 2;
+		}
+	}
+	
+	configs = (struct YLinkSimConfig*) malloc(count * sizeof(*configs));
+	reports = (struct YLinkSimReport*) malloc(count * sizeof(*reports));
+	if (configs == NULL || reports == NULL)
+	{
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	
+	// Configuration i takes value (i / product of counts of following axes) % count of every axis
+	for (i = 0; i < count; ++i)
+	{
+		YLinkSimDefaultConfig(&configs[i]);
+		index = i;
+		for (j = axes_count; j > 0; --j)
+		{
+			YLinkSweepSet(&configs[i], axes[j - 1].parameter_, axes[j - 1].values_[index % axes[j - 1].count_]);
+			index /= axes[j - 1].count_;
+		}
+	}
+	YLinkSimSweep(configs, reports, count);
+	
+	for (i = 0; i < count; ++i)
+	{
+		YLinkSweepPrint(&configs[i], &reports[i]);
+	}
+	free(configs);
+	free(reports);
+	return 0;
+}
@@ -0,0 +1,558 @@
+#define _GNU_SOURCE
+#include "YProtocol.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*!
+ * \brief Load generator of gateway daemon (see ygateway.c), it measures scaling of echoed packets per second
+ * from 1 to N workers. For every number of workers gateway is started with it, the same number of client threads
+ * open links to gateway, keep given number of request packets in flight on every link and parse replies by their own
+ * contexts of protocol. Replies are counted after warmup during given time, then gateway is stopped.
+ * Every number of workers prints one JSON object per line.
+ * Usage: yloadgen [-g gateway] [-w max_workers] [-l links_per_client] [-n in_flight] [-s data_size] [-d seconds]
+ * [-p port] [-c]
+ * -g - path of gateway, default is ./ygateway, -c - COBS framing
+ */
+
+//! default port of gateway
+#define Y_LOADGEN_PORT 7778
+
+//! size of FIFOs of link, it must fit in-flight requests and their replies
+#define Y_LOADGEN_BUFFERS_SIZE 16384
+
+//! function code of requests
+#define Y_LOADGEN_FC 1
+
+//! maximum size of encoded request
+#define Y_LOADGEN_REQUEST_SIZE 512
+
+//! maximum data size of request, encoded request fits into Y_LOADGEN_REQUEST_SIZE in both framings
+#define Y_LOADGEN_MAX_DATA_SIZE (Y_LOADGEN_REQUEST_SIZE - 16)
+
+//! number of requests in block of requests, links write from it
+#define Y_LOADGEN_BLOCK_REQUESTS 64
+
+//! events taken from epoll at once
+#define Y_LOADGEN_EVENTS 64
+
+//! maximum number of client threads
+#define Y_LOADGEN_CLIENTS 256
+
+struct YLoadgenClient;
+
+/*!
+ * \brief Link of client
+ * \member protocol_ - context of protocol, it parses replies
+ * \member client_ - client that owns link
+ * \member fd_ - socket
+ * \member tx_owed_ - bytes of requests that haven't been written yet
+ * \member tx_position_ - position of the next written byte in block of requests
+ * \member events_ - events of epoll
+ */
+struct YLoadgenLink
+{
+	struct YProtocol protocol_;
+	struct YLoadgenClient *client_;
+	int fd_;
+	uint64_t tx_owed_;
+	uint32_t tx_position_;
+	uint32_t events_;
+};
+
+/*!
+ * \brief Client thread
+ * \member thread_ - thread of client
+ * \member epoll_fd_ - epoll
+ * \member links_ - links
+ * \member links_count_ - number of links
+ * \member replies_ - parsed replies, it is read by main thread
+ * \member errors_ - failed links
+ */
+struct YLoadgenClient
+{
+	pthread_t thread_;
+	int epoll_fd_;
+	struct YLoadgenLink *links_;
+	uint32_t links_count_;
+	uint64_t replies_;
+	uint32_t errors_;
+};
+
+/*!
+ * \brief Block of encoded requests
+ * \member data_ - Y_LOADGEN_BLOCK_REQUESTS requests
+ * \member request_size_ - size of one request
+ * \member size_ - size of data_
+ */
+struct YLoadgenBlock
+{
+	uint8_t data_[Y_LOADGEN_BLOCK_REQUESTS * Y_LOADGEN_REQUEST_SIZE];
+	uint32_t request_size_;
+	uint32_t size_;
+};
+
+//! requests written by every link
+static struct YLoadgenBlock block;
+
+//! framing of links
+static uint8_t framing = Y_PROTOCOL_FRAMING_LENGTH;
+
+//! clients stop when it is set
+static int stopping;
+
+double YLoadgenSeconds(void)
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+void YLoadgenSleep(double seconds)
+{
+	struct timespec ts;
+	
+	ts.tv_sec = (time_t) seconds;
+	ts.tv_nsec = (long) ((seconds - (double) ts.tv_sec) * 1e9);
+	nanosleep(&ts, NULL);
+}
+
+uint8_t YLoadgenReadByte(struct YProtocol *protocol)
+{
+	return 0;
+}
+
+void YLoadgenSendByte(struct YProtocol *protocol, uint8_t byte)
+{
+	struct YLoadgenBlock *encoded = (struct YLoadgenBlock*) YProtocolUserData(protocol);
+	
+	if (encoded != NULL && encoded->size_ < sizeof(encoded->data_))
+	{
+		encoded->data_[encoded->size_++] = byte;
+	}
+}
+
+void YLoadgenEnableTransmit(struct YProtocol *protocol, YBOOL enabled)
+{
+}
+
+int32_t YLoadgenProcess(struct YProtocol *protocol)
+{
+	struct YLoadgenLink *link = (struct YLoadgenLink*) YProtocolUserData(protocol);
+	
+	// Every reply is followed by the next request, so number of requests in flight stays the same
+	__atomic_store_n(&link->client_->replies_, link->client_->replies_ + 1, __ATOMIC_RELAXED);
+	link->tx_owed_ += block.request_size_;
+	return Y_PARSE_IS_OK;
+}
+
+int YLoadgenEncode(uint32_t data_size)
+{
+	static struct YProtocol encoder;
+	uint8_t data[Y_LOADGEN_MAX_DATA_SIZE];
+	uint32_t i;
+	
+	if (data_size > Y_LOADGEN_MAX_DATA_SIZE)
+	{
+		return -1;
+	}
+	
+	// Request is encoded by protocol itself and repeated, so block holds whole number of requests
+	for (i = 0; i < data_size; ++i)
+	{
+		data[i] = (uint8_t) (i * 7 + 1);
+	}
+	YProtocolInit(&encoder, Y_LOADGEN_BUFFERS_SIZE, YLoadgenReadByte, YLoadgenSendByte, YLoadgenProcess,
+		YLoadgenEnableTransmit);
+	YProtocolSetFraming(&encoder, framing);
+	YProtocolSetUserData(&encoder, &block);
+	block.size_ = 0;
+	YProtocolSendPacket(&encoder, Y_LOADGEN_FC, data, data_size);
+	while (YProtocolInterrupt(&encoder, YFALSE) == Y_PARSE_IS_OK)
+	{
+	}
+	YProtocolDeinit(&encoder);
+	if (block.size_ == 0 || block.size_ > Y_LOADGEN_REQUEST_SIZE)
+	{
+		return -1;
+	}
+	block.request_size_ = block.size_;
+	for (i = 1; i < Y_LOADGEN_BLOCK_REQUESTS; ++i)
+	{
+		memcpy(&block.data_[i * block.request_size_], block.data_, block.request_size_);
+	}
+	block.size_ = Y_LOADGEN_BLOCK_REQUESTS * block.request_size_;
+	return 0;
+}
+
+int YLoadgenConnect(uint16_t port)
+{
+	struct sockaddr_in address;
+	int fd, enabled = 1;
+	
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return -1;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+	if (connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	return fd;
+}
+
+int YLoadgenFlush(struct YLoadgenLink *link)
+{
+	uint64_t size;
+	ssize_t written;
+	
+	while (link->tx_owed_ != 0)
+	{
+		size = block.size_ - link->tx_position_;
+		if (size > link->tx_owed_)
+		{
+			size = link->tx_owed_;
+		}
+		written = send(link->fd_, &block.data_[link->tx_position_], (size_t) size, MSG_NOSIGNAL);
+		if (written < 0)
+		{
+			return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+		}
+		link->tx_owed_ -= (uint64_t) written;
+		link->tx_position_ = (link->tx_position_ + (uint32_t) written) % block.size_;
+	}
+	return 0;
+}
+
+int YLoadgenRead(struct YLoadgenLink *link)
+{
+	uint8_t data[Y_LOADGEN_BUFFERS_SIZE / 2];
+	ssize_t count;
+	
+	count = read(link->fd_, data, sizeof(data));
+	if (count == 0)
+	{
+		return -1;
+	}
+	if (count < 0)
+	{
+		return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+	}
+	YProtocolReceive(&link->protocol_, data, (uint32_t) count);
+	while (YProtocolThread(&link->protocol_) != Y_PARSE_FIFO_EMPTY)
+	{
+	}
+	return 0;
+}
+
+int YLoadgenUpdate(struct YLoadgenLink *link)
+{
+	struct epoll_event event;
+	uint32_t events = (link->tx_owed_ != 0) ? EPOLLIN | EPOLLOUT : EPOLLIN;
+	
+	if (events == link->events_)
+	{
+		return 0;
+	}
+	link->events_ = events;
+	event.events = events;
+	event.data.ptr = link;
+	return epoll_ctl(link->client_->epoll_fd_, EPOLL_CTL_MOD, link->fd_, &event);
+}
+
+void* YLoadgenWork(void *argument)
+{
+	struct YLoadgenClient *client = (struct YLoadgenClient*) argument;
+	struct epoll_event events[Y_LOADGEN_EVENTS];
+	struct YLoadgenLink *link;
+	int count, i, err;
+	
+	while (__atomic_load_n(&stopping, __ATOMIC_RELAXED) == 0)
+	{
+		count = epoll_wait(client->epoll_fd_, events, Y_LOADGEN_EVENTS, 100);
+		for (i = 0; i < count; ++i)
+		{
+			link = (struct YLoadgenLink*) events[i].data.ptr;
+			err = 0;
+			if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+			{
+				err = YLoadgenRead(link);
+			}
+			if (err == 0)
+			{
+				err = YLoadgenFlush(link);
+			}
+			if (err == 0)
+			{
+				err = YLoadgenUpdate(link);
+			}
+			if (err != 0)
+			{
+				epoll_ctl(client->epoll_fd_, EPOLL_CTL_DEL, link->fd_, NULL);
+				client->errors_++;
+			}
+		}
+	}
+	return NULL;
+}
+
+int YLoadgenOpen(struct YLoadgenClient *client, uint32_t links_count, uint32_t in_flight, uint16_t port)
+{
+	struct YLoadgenLink *link;
+	struct epoll_event event;
+	uint32_t i;
+	
+	client->links_ = NULL;
+	client->links_count_ = 0;
+	client->epoll_fd_ = epoll_create1(0);
+	client->links_ = (struct YLoadgenLink*) calloc(links_count, sizeof(*client->links_));
+	client->replies_ = 0;
+	client->errors_ = 0;
+	if (client->epoll_fd_ < 0 || client->links_ == NULL)
+	{
+		return -1;
+	}
+	for (i = 0; i < links_count; ++i)
+	{
+		link = &client->links_[i];
+		link->client_ = client;
+		link->fd_ = YLoadgenConnect(port);
+		if (link->fd_ < 0)
+		{
+			return -1;
+		}
+		YProtocolInit(&link->protocol_, Y_LOADGEN_BUFFERS_SIZE, YLoadgenReadByte, YLoadgenSendByte, YLoadgenProcess,
+			YLoadgenEnableTransmit);
+		YProtocolSetFraming(&link->protocol_, framing);
+		YProtocolSetUserData(&link->protocol_, link);
+		client->links_count_++;
+	
+		link->tx_owed_ = (uint64_t) in_flight * block.request_size_;
+		link->events_ = EPOLLIN | EPOLLOUT;
+		event.events = link->events_;
+		event.data.ptr = link;
+		if (epoll_ctl(client->epoll_fd_, EPOLL_CTL_ADD, link->fd_, &event) != 0)
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void YLoadgenClose(struct YLoadgenClient *client)
+{
+	uint32_t i;
+	
+	for (i = 0; i < client->links_count_; ++i)
+	{
+		close(client->links_[i].fd_);
+		YProtocolDeinit(&client->links_[i].protocol_);
+	}
+	free(client->links_);
+	client->links_ = NULL;
+	if (client->epoll_fd_ >= 0)
+	{
+		close(client->epoll_fd_);
+	}
+}
+
+pid_t YLoadgenStartGateway(const char *gateway, uint32_t workers, uint16_t port)
+{
+	char workers_argument[16], port_argument[16];
+	double deadline;
+	pid_t pid;
+	int fd;
+	
+	snprintf(workers_argument, sizeof(workers_argument), "%u", workers);
+	snprintf(port_argument, sizeof(port_argument), "%u", port);
+	pid = fork();
+	if (pid == 0)
+	{
+		// Output of gateway isn't mixed with output of load generator
+		fd = open("/dev/null", O_WRONLY);
+		dup2(fd, STDOUT_FILENO);
+		execl(gateway, gateway, "-w", workers_argument, "-p", port_argument,
+			(framing == Y_PROTOCOL_FRAMING_COBS) ? "-c" : NULL, (char*) NULL);
+		perror(gateway);
+		_exit(127);
+	}
+	if (pid < 0)
+	{
+		return -1;
+	}
+	
+	// Gateway is ready when it accepts connection
+	deadline = YLoadgenSeconds() + 5.0;
+	while (YLoadgenSeconds() < deadline)
+	{
+		fd = YLoadgenConnect(port);
+		if (fd >= 0)
+		{
+			close(fd);
+			return pid;
+		}
+		if (waitpid(pid, NULL, WNOHANG) == pid)
+		{
+			return -1;
+		}
+		YLoadgenSleep(0.01);
+	}
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+	return -1;
+}
+
+uint64_t YLoadgenReplies(struct YLoadgenClient *clients, uint32_t count)
+{
+	uint64_t replies = 0;
+	uint32_t i;
+	
+	for (i = 0; i < count; ++i)
+	{
+		replies += __atomic_load_n(&clients[i].replies_, __ATOMIC_RELAXED);
+	}
+	return replies;
+}
+
+int main(int argc, char **argv)
+{
+	static struct YLoadgenClient clients[Y_LOADGEN_CLIENTS];
+	const char *gateway = "./ygateway";
+	uint32_t max_workers = (uint32_t) sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t links_count = 8;
+	uint32_t in_flight = 16;
+	uint32_t data_size = 16;
+	double seconds = 2.0;
+	double warmup, start, elapsed;
+	uint64_t replies;
+	uint32_t workers, i, errors;
+	uint16_t port = Y_LOADGEN_PORT;
+	pid_t pid;
+	int option, err;
+	
+	while ((option = getopt(argc, argv, "g:w:l:n:s:d:p:c")) != -1)
+	{
+		switch (option)
+		{
+		case 'g':
+			gateway = optarg;
+			break;
+		case 'w':
+			max_workers = (uint32_t) strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			links_count = (uint32_t) strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			in_flight = (uint32_t) strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			data_size = (uint32_t) strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			seconds = strtod(optarg, NULL);
+			break;
+		case 'p':
+			port = (uint16_t) strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			framing = Y_PROTOCOL_FRAMING_COBS;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-g gateway] [-w max_workers] [-l links_per_client] [-n in_flight] "
+				"[-s data_size] [-d seconds] [-p port] [-c]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (max_workers == 0 || max_workers > Y_LOADGEN_CLIENTS || links_count == 0 || in_flight == 0 ||
+		YLoadgenEncode(data_size) != 0 || (uint64_t) in_flight * block.request_size_ * 2 > Y_LOADGEN_BUFFERS_SIZE)
+	{
+		fprintf(stderr, "at most %u workers, data size at most %u, in-flight requests and their replies must fit "
+			"into %u bytes\n", Y_LOADGEN_CLIENTS, Y_LOADGEN_MAX_DATA_SIZE, Y_LOADGEN_BUFFERS_SIZE);
+		return 2;
+	}
+	warmup = seconds / 4;
+	
+	for (workers = 1; workers <= max_workers; ++workers)
+	{
+		pid = YLoadgenStartGateway(gateway, workers, port);
+		if (pid < 0)
+		{
+			fprintf(stderr, "%s hasn't started\n", gateway);
+			return 1;
+		}
+	
+		__atomic_store_n(&stopping, 0, __ATOMIC_RELAXED);
+		err = 0;
+		for (i = 0; i < workers; ++i)
+		{
+			if (YLoadgenOpen(&clients[i], links_count, in_flight, port) != 0)
+			{
+				err = 1;
+			}
+		}
+		for (i = 0; i < workers && err == 0; ++i)
+		{
+			pthread_create(&clients[i].thread_, NULL, YLoadgenWork, &clients[i]);
+		}
+	
+		replies = 0;
+		elapsed = 0.0;
+		if (err == 0)
+		{
+			YLoadgenSleep(warmup);
+			replies = YLoadgenReplies(clients, workers);
+			start = YLoadgenSeconds();
+			YLoadgenSleep(seconds);
+			replies = YLoadgenReplies(clients, workers) - replies;
+			elapsed = YLoadgenSeconds() - start;
+			__atomic_store_n(&stopping, 1, __ATOMIC_RELAXED);
+			for (i = 0; i < workers; ++i)
+			{
+				pthread_join(clients[i].thread_, NULL);
+			}
+		}
+		errors = 0;
+		for (i = 0; i < workers; ++i)
+		{
+			errors += clients[i].errors_;
+			YLoadgenClose(&clients[i]);
+		}
+		kill(pid, SIGTERM);
+		waitpid(pid, NULL, 0);
+		if (err != 0)
+		{
+			fprintf(stderr, "links haven't been opened\n");
+			return 1;
+		}
+	
+		printf("{\"workers\":%u,\"clients\":%u,\"links\":%u,\"in_flight\":%u,\"data_size\":%u,\"framing\":%u,"
+			"\"frames\":%llu,\"seconds\":%.3f,\"frames_per_second\":%.0f,\"errors\":%u}\n", workers, workers,
+			workers * links_count, in_flight, data_size, framing, (unsigned long long) replies, elapsed,
+			(elapsed > 0.0) ? (double) replies / elapsed : 0.0, errors);
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,279 @@
+#include "YProtocol.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*!
+ * \brief Stress test of multi-producer sending on host, it should be run under ThreadSanitizer too (see Makefile).
+ * Several producer threads call YProtocolSendPacket() at the same time on one context in multi-producer mode,
+ * they retry if outcoming FIFO is full. Main thread is transmitter: it drains outcoming FIFO by YProtocolInterrupt()
+ * (transmit interrupt) and passes every transmitted byte to reciever that parses it. Reciever checks CRC of every
+ * frame, test requires that there are no parsing errors, every packet has own producer and sequence number, packets
+ * of every producer come in order and total number of packets is right. DMA transmitter isn't used, because on host
+ * YProtocolDisableIrq() doesn't exclude producers that start it.
+ * Usage: ympstress [-c] [-p producers] [-n packets per producer], -c - COBS framing, exit code is 0 if test passes
+ */
+
+//! size of outcoming FIFO of sender, it is small, so producers often wait for free space
+#define Y_MP_STRESS_TX_SIZE 512
+
+//! size of FIFOs of reciever
+#define Y_MP_STRESS_RX_SIZE 1024
+
+//! maximum number of producers
+#define Y_MP_STRESS_MAX_PRODUCERS 16
+
+//! maximum size of data of packets
+#define Y_MP_STRESS_MAX_DATA_SIZE 128
+
+//! size of header of data: sequence number (low byte first)
+#define Y_MP_STRESS_HEADER_SIZE 4
+
+//! test fails if transmitter has nothing to transmit so long, seconds
+#define Y_MP_STRESS_TIMEOUT 10
+
+/*!
+ * \brief Producer
+ * \member sender_ - context that is shared by producers
+ * \member id_ - number of producer, function code of its packets is id_ + 1
+ * \member packets_ - number of packets to send
+ * \member retries_ - number of retries because outcoming FIFO has been full
+ */
+struct YMpStressProducer
+{
+	struct YProtocol *sender_;
+	uint32_t id_;
+	uint32_t packets_;
+	uint32_t retries_;
+};
+
+/*!
+ * \brief Reciever
+ * \member protocol_ - context of reciever
+ * \member expected_ - expected sequence number of next packet of every producer
+ * \member producers_ - number of producers
+ * \member handled_ - recieved packets
+ * \member wrong_ - packets with wrong producer, sequence number or data
+ */
+struct YMpStressReciever
+{
+	struct YProtocol protocol_;
+	uint32_t expected_[Y_MP_STRESS_MAX_PRODUCERS];
+	uint32_t producers_;
+	uint32_t handled_;
+	uint32_t wrong_;
+};
+
+//! reciever of transmitted bytes, it is used only by transmitter
+static struct YMpStressReciever reciever;
+
+double YMpStressSeconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+uint8_t YMpStressPattern(uint32_t id, uint32_t sequence, uint32_t i)
+{
+	return (uint8_t) (id * 67 + sequence * 31 + i);
+}
+
+uint32_t YMpStressDataSize(uint32_t id, uint32_t sequence)
+{
+	return Y_MP_STRESS_HEADER_SIZE + (id * 7 + sequence * 13) % (Y_MP_STRESS_MAX_DATA_SIZE - Y_MP_STRESS_HEADER_SIZE + 1);
+}
+
+uint8_t YMpStressReadByte(struct YProtocol *protocol)
+{
+	return 0;
+}
+
+void YMpStressSendByte(struct YProtocol *protocol, uint8_t byte)
+{
+	// Sender transmits byte into reciever, which parses it at once
+	YProtocolReceive(&reciever.protocol_, &byte, 1);
+	while (YProtocolThread(&reciever.protocol_) != Y_PARSE_FIFO_EMPTY)
+	{
+	}
+}
+
+void YMpStressEnableTransmit(struct YProtocol *protocol, YBOOL enabled)
+{
+}
+
+int32_t YMpStressProcess(struct YProtocol *protocol)
+{
+	uint8_t *data = YProtocolParsedData(protocol);
+	uint32_t size = YProtocolParsedDataSize(protocol);
+	uint32_t id = (uint32_t) YProtocolFunctionCode(protocol) - 1;
+	uint32_t sequence, i;
+
+	reciever.handled_++;
+	if (id >= reciever.producers_ || size < Y_MP_STRESS_HEADER_SIZE)
+	{
+		reciever.wrong_++;
+		return Y_PARSE_IS_OK;
+	}
+
+	sequence = ((uint32_t) data[0]) | (((uint32_t) data[1]) << 8) | (((uint32_t) data[2]) << 16) |
+		(((uint32_t) data[3]) << 24);
+	if (sequence != reciever.expected_[id] || size != YMpStressDataSize(id, sequence))
+	{
+		reciever.wrong_++;
+	}
+	else
+	{
+		for (i = Y_MP_STRESS_HEADER_SIZE; i < size; ++i)
+		{
+			if (data[i] != YMpStressPattern(id, sequence, i))
+			{
+				reciever.wrong_++;
+				break;
+			}
+		}
+	}
+	reciever.expected_[id] = sequence + 1;
+	return Y_PARSE_IS_OK;
+}
+
+void* YMpStressProduce(void *arg)
+{
+	struct YMpStressProducer *producer = (struct YMpStressProducer*) arg;
+	uint8_t data[Y_MP_STRESS_MAX_DATA_SIZE];
+	uint32_t sequence, size, i;
+
+	for (sequence = 0; sequence < producer->packets_; ++sequence)
+	{
+		size = YMpStressDataSize(producer->id_, sequence);
+		data[0] = (uint8_t) sequence;
+		data[1] = (uint8_t) (sequence >> 8);
+		data[2] = (uint8_t) (sequence >> 16);
+		data[3] = (uint8_t) (sequence >> 24);
+		for (i = Y_MP_STRESS_HEADER_SIZE; i < size; ++i)
+		{
+			data[i] = YMpStressPattern(producer->id_, sequence, i);
+		}
+
+		// Packet is sent completely or not at all, so it is sent again until there is space for it
+		while (YProtocolSendPacket(producer->sender_, (uint8_t) (producer->id_ + 1), data, size) != Y_PARSE_IS_OK)
+		{
+			producer->retries_++;
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	static struct YProtocol sender;
+	static struct YMpStressProducer producers[Y_MP_STRESS_MAX_PRODUCERS];
+	pthread_t threads[Y_MP_STRESS_MAX_PRODUCERS];
+	struct YProtocolStats stats;
+	uint32_t producers_count = 4;
+	uint32_t packets = 5000;
+	uint8_t framing = Y_PROTOCOL_FRAMING_LENGTH;
+	uint32_t expected, retries = 0, i;
+	uint32_t last_handled = 0;
+	double idle_since;
+	YBOOL passed;
+	int option;
+
+	while ((option = getopt(argc, argv, "cp:n:")) != -1)
+	{
+		switch (option)
+		{
+			case 'c':
+				framing = Y_PROTOCOL_FRAMING_COBS;
+				break;
+			case 'p':
+				producers_count = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+			case 'n':
+				packets = (uint32_t) strtoul(optarg, NULL, 0);
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-c] [-p producers] [-n packets per producer]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (producers_count == 0 || producers_count > Y_MP_STRESS_MAX_PRODUCERS)
+	{
+		fprintf(stderr, "number of producers must be 1..%u\n", Y_MP_STRESS_MAX_PRODUCERS);
+		return 1;
+	}
+	expected = producers_count * packets;
+
+	YProtocolInit(&sender, Y_MP_STRESS_TX_SIZE, YMpStressReadByte, YMpStressSendByte, YMpStressProcess,
+		YMpStressEnableTransmit);
+	YProtocolSetFraming(&sender, framing);
+	YProtocolEnableMultiProducer(&sender, YTRUE);
+	YProtocolInit(&reciever.protocol_, Y_MP_STRESS_RX_SIZE, YMpStressReadByte, YMpStressSendByte, YMpStressProcess,
+		YMpStressEnableTransmit);
+	YProtocolSetFraming(&reciever.protocol_, framing);
+	YProtocolResetStats(&reciever.protocol_);
+	reciever.producers_ = producers_count;
+
+	for (i = 0; i < producers_count; ++i)
+	{
+		producers[i].sender_ = &sender;
+		producers[i].id_ = i;
+		producers[i].packets_ = packets;
+		pthread_create(&threads[i], NULL, YMpStressProduce, &producers[i]);
+	}
+
+	// Transmitter runs until all packets are recieved or nothing is recieved for long time
+	idle_since = YMpStressSeconds();
+	while (reciever.handled_ < expected)
+	{
+		if (YProtocolInterrupt(&sender, YFALSE) != Y_PARSE_IS_OK)
+		{
+			if (reciever.handled_ != last_handled)
+			{
+				last_handled = reciever.handled_;
+				idle_since = YMpStressSeconds();
+			}
+			else if (YMpStressSeconds() - idle_since > Y_MP_STRESS_TIMEOUT)
+			{
+				break;
+			}
+			sched_yield();
+		}
+	}
+
+	for (i = 0; i < producers_count; ++i)
+	{
+		pthread_join(threads[i], NULL);
+		retries += producers[i].retries_;
+	}
+	while (YProtocolInterrupt(&sender, YFALSE) == Y_PARSE_IS_OK)
+	{
+	}
+
+	YProtocolGetStats(&reciever.protocol_, &stats);
+	passed = (reciever.handled_ == expected && reciever.wrong_ == 0 && stats.error_bc_ == 0 && stats.error_crc_ == 0 &&
+		stats.error_cobs_ == 0 && stats.error_fifo_full_ == 0) ? YTRUE : YFALSE;
+	for (i = 0; i < producers_count; ++i)
+	{
+		if (reciever.expected_[i] != packets)
+		{
+			passed = YFALSE;
+		}
+	}
+	printf("{\"test\":\"multi_producer\",\"framing\":\"%s\",\"producers\":%u,\"expected\":%u,\"handled\":%u,"
+		"\"wrong\":%u,\"error_bc\":%u,\"error_crc\":%u,\"error_cobs\":%u,\"error_fifo_full\":%u,\"retries\":%u,"
+		"\"passed\":%s}\n", (framing == Y_PROTOCOL_FRAMING_COBS) ? "cobs" : "length", producers_count, expected,
+		reciever.handled_, reciever.wrong_, stats.error_bc_, stats.error_crc_, stats.error_cobs_, stats.error_fifo_full_,
+		retries, (passed == YTRUE) ? "true" : "false");
+
+	YProtocolDeinit(&reciever.protocol_);
+	YProtocolDeinit(&sender);
+	return (passed == YTRUE) ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+#include "YProtocol.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*!
+ * \brief Host replayer of capture (see YCapture.h) that has been dumped from device into file. File is mapped into
+ * memory and recieved (or transmitted) bytes are passed to parser at full speed or paced by timestamps of capture.
+ * Every parsed packet can be printed and summary is printed at the end, one JSON object per line.
+ * Usage: yreplay [-c] [-t] [-v] [-p] capture
+ * -c - COBS framing, -t - replay transmitted bytes, -v - print parsed packets,
+ * -p - pace bytes by timestamps, ticks per second are taken from header of capture
+ */
+
+//! size of FIFOs, enough for packets of any device
+#define Y_REPLAY_BUFFERS_SIZE 4096
+
+/*!
+ * \brief Replay
+ * \member protocol_ - context of protocol
+ * \member is_recieved_ - direction of replayed bytes
+ * \member verbose_ - parsed packets are printed
+ * \member ticks_per_second_ - ticks of capture per second, 0 for full speed
+ * \member start_ - time of beginning of replay, ns
+ * \member timestamp_ - timestamp of current byte
+ * \member bytes_ - replayed bytes
+ * \member frames_ - parsed packets
+ */
+struct YReplay
+{
+	struct YProtocol protocol_;
+	YBOOL is_recieved_;
+	YBOOL verbose_;
+	uint64_t ticks_per_second_;
+	uint64_t start_;
+	uint64_t timestamp_;
+	uint32_t bytes_;
+	uint32_t frames_;
+};
+
+uint64_t YReplayNow(void)
+{
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+uint8_t YReplayReadByte(struct YProtocol *protocol)
+{
+	return 0;
+}
+
+void YReplaySendByte(struct YProtocol *protocol, uint8_t byte)
+{
+}
+
+void YReplayEnableTransmit(struct YProtocol *protocol, YBOOL enabled)
+{
+}
+
+int32_t YReplayProcess(struct YProtocol *protocol)
+{
+	struct YReplay *replay = (struct YReplay*) YProtocolUserData(protocol);
+	
+	if (replay->verbose_ == YTRUE)
+	{
+		printf("{\"packet\":%u,\"timestamp\":%llu,\"fc\":%u,\"size\":%u}\n", replay->frames_,
+			(unsigned long long) replay->timestamp_,
+			YProtocolFunctionCode(protocol), YProtocolParsedDataSize(protocol));
+	}
+	replay->frames_++;
+	return Y_PARSE_IS_OK;
+}
+
+void YReplayRecord(void *user_data, uint64_t timestamp, YBOOL is_recieved, uint8_t byte)
+{
+	struct YReplay *replay = (struct YReplay*) user_data;
+	uint64_t due;
+	struct timespec ts;
+	
+	if (is_recieved != replay->is_recieved_)
+	{
+		return;
+	}
+	
+	// Byte is passed to parser when its time since beginning of replay comes
+	if (replay->ticks_per_second_ != 0)
+	{
+		due = replay->start_ + timestamp / replay->ticks_per_second_ * 1000000000u +
+			timestamp % replay->ticks_per_second_ * 1000000000u / replay->ticks_per_second_;
+		ts.tv_sec = (time_t) (due / 1000000000u);
+		ts.tv_nsec = (long) (due % 1000000000u);
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	}
+	
+	replay->timestamp_ = timestamp;
+	replay->bytes_++;
+	YProtocolReceive(&replay->protocol_, &byte, 1);
+	while (YProtocolThread(&replay->protocol_) != Y_PARSE_FIFO_EMPTY)
+	{
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static struct YReplay replay;
+	struct YProtocolStats stats;
+	struct stat file_stat;
+	uint8_t framing = Y_PROTOCOL_FRAMING_LENGTH;
+	const uint8_t *log;
+	uint32_t ticks_per_second = 0;
+	YBOOL paced = YFALSE;
+	uint32_t err;
+	uint64_t elapsed;
+	int option, fd;
+	
+	replay.is_recieved_ = YTRUE;
+	replay.verbose_ = YFALSE;
+	while ((option = getopt(argc, argv, "ctvp")) != -1)
+	{
+		switch (option)
+		{
+		case 'c':
+			framing = Y_PROTOCOL_FRAMING_COBS;
+			break;
+		case 't':
+			replay.is_recieved_ = YFALSE;
+			break;
+		case 'v':
+			replay.verbose_ = YTRUE;
+			break;
+		case 'p':
+			paced = YTRUE;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-c] [-t] [-v] [-p] capture\n", argv[0]);
+			return 2;
+		}
+	}
+	if (optind >= argc)
+	{
+		fprintf(stderr, "usage: %s [-c] [-t] [-v] [-p] capture\n", argv[0]);
+		return 2;
+	}
+	
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0 || fstat(fd, &file_stat) != 0)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	log = NULL;
+	if (file_stat.st_size > 0)
+	{
+		log = (const uint8_t*) mmap(NULL, (size_t) file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (log == MAP_FAILED)
+		{
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+	
+	if (YCaptureReadHeader(log, (uint32_t) file_stat.st_size, &ticks_per_second) != Y_CAPTURE_NO_ERROR)
+	{
+		fprintf(stderr, "%s: wrong header of capture\n", argv[optind]);
+		return 1;
+	}
+	if (paced == YTRUE)
+	{
+		if (ticks_per_second == 0)
+		{
+			fprintf(stderr, "%s: ticks per second are unknown, capture can't be paced\n", argv[optind]);
+			return 1;
+		}
+		replay.ticks_per_second_ = ticks_per_second;
+	}
+	
+	YProtocolInit(&replay.protocol_, Y_REPLAY_BUFFERS_SIZE, YReplayReadByte, YReplaySendByte, YReplayProcess,
+		YReplayEnableTransmit);
+	YProtocolSetFraming(&replay.protocol_, framing);
+	YProtocolSetUserData(&replay.protocol_, &replay);
+	
+	replay.start_ = YReplayNow();
+	err = YCaptureReplay(log, (uint32_t) file_stat.st_size, YReplayRecord, &replay);
+	elapsed = YReplayNow() - replay.start_;
+	
+	YProtocolGetStats(&replay.protocol_, &stats);
+	printf("{\"bytes\":%u,\"frames\":%u,\"error_bc\":%u,\"error_crc\":%u,\"error_cobs\":%u,\"truncated\":%s,"
+		"\"seconds\":%.6f}\n", replay.bytes_, replay.frames_, stats.error_bc_, stats.error_crc_, stats.error_cobs_,
+		(err == Y_CAPTURE_NO_ERROR) ? "false" : "true", (double) elapsed * 1e-9);
+	
+	YProtocolDeinit(&replay.protocol_);
+	if (log != NULL)
+	{
+		munmap((void*) log, (size_t) file_stat.st_size);
+	}
+	close(fd);
+	return (err == Y_CAPTURE_NO_ERROR) ? 0 : 1;
+}
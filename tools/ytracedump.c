@@ -0,0 +1,114 @@
+#include "YProtocol.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*!
+ * \brief Host dump tool of latency trace. File is raw struct YProtocolTrace copied by YProtocolGetTrace() on device
+ * (for example by debugger), tool must be built with the same YPROTOCOL_TRACE_SIZE and YPROTOCOL_TRACE_BUCKETS
+ * as firmware, for example: make ytracedump CFLAGS="-O2 -DYPROTOCOL_TRACE_SIZE=32". Device must be little-endian.
+ * Records of the last packets (oldest first) with latencies of their stages and histograms of stages are printed
+ * as one JSON object per line, latencies are ticks of trace timer, stage is null if it is unknown or isn't finished.
+ * Usage: ytracedump trace
+ */
+
+//! names of stages
+static const char *stage_names[Y_TRACE_STAGES] = {"receive", "queue", "handler", "reply", "total"};
+
+void YTraceDumpLatency(const char *name, YBOOL valid, uint32_t begin, uint32_t end, YBOOL last)
+{
+	if (valid == YTRUE)
+	{
+		printf("\"%s\":%u%s", name, end - begin, (last == YTRUE) ? "" : ",");
+	}
+	else
+	{
+		printf("\"%s\":null%s", name, (last == YTRUE) ? "" : ",");
+	}
+}
+
+void YTraceDumpRecord(uint32_t packet, const struct YProtocolTraceRecord *record)
+{
+	YBOOL received = (record->flags_ & Y_TRACE_FLAG_RECEIVED) ? YTRUE : YFALSE;
+	YBOOL handled = (record->flags_ & Y_TRACE_FLAG_HANDLED) ? YTRUE : YFALSE;
+	YBOOL reply = (record->flags_ & Y_TRACE_FLAG_REPLY) ? YTRUE : YFALSE;
+	YBOOL sent = (record->flags_ & Y_TRACE_FLAG_SENT) ? YTRUE : YFALSE;
+	YBOOL finished = (handled == YTRUE && (reply == YFALSE || sent == YTRUE)) ? YTRUE : YFALSE;
+	
+	printf("{\"packet\":%u,\"fc\":%u,\"handled\":%s,\"reply\":%s,\"sent\":%s,\"rx_first\":%u,", packet, record->fc_,
+		(handled == YTRUE) ? "true" : "false", (reply == YTRUE) ? "true" : "false", (sent == YTRUE) ? "true" : "false",
+		record->rx_first_);
+	YTraceDumpLatency(stage_names[Y_TRACE_STAGE_RECEIVE], received, record->rx_first_, record->parsed_, YFALSE);
+	YTraceDumpLatency(stage_names[Y_TRACE_STAGE_QUEUE], handled, record->parsed_, record->handler_entry_, YFALSE);
+	YTraceDumpLatency(stage_names[Y_TRACE_STAGE_HANDLER], handled, record->handler_entry_, record->handler_exit_, YFALSE);
+	YTraceDumpLatency(stage_names[Y_TRACE_STAGE_REPLY], sent, record->reply_enqueued_, record->reply_sent_, YFALSE);
+	YTraceDumpLatency(stage_names[Y_TRACE_STAGE_TOTAL], (received == YTRUE && finished == YTRUE) ? YTRUE : YFALSE,
+		record->rx_first_, (reply == YTRUE) ? record->reply_sent_ : record->handler_exit_, YTRUE);
+	printf("}\n");
+}
+
+void YTraceDumpHistogram(uint32_t stage, const uint32_t *histogram)
+{
+	uint32_t bucket;
+	
+	// Bucket N counts latencies of N significant bits, last bucket counts all longer latencies
+	printf("{\"stage\":\"%s\",\"buckets\":[", stage_names[stage]);
+	for (bucket = 0; bucket < YPROTOCOL_TRACE_BUCKETS; ++bucket)
+	{
+		printf("{\"min\":%u,\"max\":", (bucket == 0) ? 0 : 1u << (bucket - 1));
+		if (bucket == YPROTOCOL_TRACE_BUCKETS - 1)
+		{
+			printf("null");
+		}
+		else
+		{
+			printf("%u", (bucket == 0) ? 0 : (1u << bucket) - 1);
+		}
+		printf(",\"count\":%u}%s", histogram[bucket], (bucket == YPROTOCOL_TRACE_BUCKETS - 1) ? "" : ",");
+	}
+	printf("]}\n");
+}
+
+int main(int argc, char **argv)
+{
+	static struct YProtocolTrace trace;
+	FILE *file;
+	uint32_t first, packet, stage;
+	long size;
+	
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: %s trace\n", argv[0]);
+		return 2;
+	}
+	file = fopen(argv[1], "rb");
+	if (file == NULL)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (size != (long) sizeof(trace) || fread(&trace, sizeof(trace), 1, file) != 1)
+	{
+		fprintf(stderr, "%s: size %ld, expected %u, check YPROTOCOL_TRACE_SIZE and YPROTOCOL_TRACE_BUCKETS\n",
+			argv[1], size, (unsigned) sizeof(trace));
+		fclose(file);
+		return 1;
+	}
+	fclose(file);
+	
+	// Ring keeps the last YPROTOCOL_TRACE_SIZE packets
+	first = (trace.count_ > YPROTOCOL_TRACE_SIZE) ? trace.count_ - YPROTOCOL_TRACE_SIZE : 0;
+	printf("{\"count\":%u,\"records\":%u}\n", trace.count_, trace.count_ - first);
+	for (packet = first; packet < trace.count_; ++packet)
+	{
+		YTraceDumpRecord(packet, &trace.records_[packet % YPROTOCOL_TRACE_SIZE]);
+	}
+	for (stage = 0; stage < Y_TRACE_STAGES; ++stage)
+	{
+		YTraceDumpHistogram(stage, trace.histograms_[stage]);
+	}
+	return 0;
+}
@@ -0,0 +1,306 @@
+#include "YProtocol.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*!
+ * \brief Regression test of latency trace on host, it must be built with YPROTOCOL_TRACE (see Makefile).
+ * Trace timer is simulated clock, every recieved byte advances it, so expected timestamps are known:
+ * - queued - packets are recieved byte by byte while thread doesn't run, then thread parses all of them,
+ * every packet must keep receiving time of its own first byte. It runs in thread, interrupt and half-duplex
+ * parsing modes of both framings
+ * - stale_reply - reply of packet is still being transmitted while YPROTOCOL_TRACE_SIZE newer packets reuse
+ * records of ring, end of reply mustn't be stamped into record of newer packet
+ * Trace of the last queued test is written into file, if it is given, for ytracedump.
+ * Usage: ytracetest [trace], exit code is number of failed tests
+ */
+
+//! size of buffers
+#define Y_TRACE_TEST_BUFFERS_SIZE 256
+
+//! number of packets of queued test, they fit into buffers together
+#define Y_TRACE_TEST_PACKETS 6
+
+//! size of data of packets
+#define Y_TRACE_TEST_DATA_SIZE 8
+
+//! ticks of simulated clock per recieved byte
+#define Y_TRACE_TEST_BYTE_TICKS 10
+
+//! parsing modes
+#define Y_TRACE_TEST_THREAD 0
+#define Y_TRACE_TEST_INTERRUPT 1
+#define Y_TRACE_TEST_HALF_DUPLEX 2
+#define Y_TRACE_TEST_MODES 3
+
+//! names of parsing modes
+static const char *mode_names[Y_TRACE_TEST_MODES] = {"thread", "interrupt", "half_duplex"};
+
+/*!
+ * \brief Test
+ * \member encoder_ - context that encodes sent packets
+ * \member reciever_ - context under test
+ * \member wire_ - encoded packets
+ * \member wire_size_ - size of wire_
+ * \member starts_ - offsets of packets in wire_
+ * \member now_ - simulated clock
+ * \member replies_ - process packet functor sends reply
+ * \member handled_ - handled packets
+ */
+struct YTraceTest
+{
+	struct YProtocol encoder_;
+	struct YProtocol reciever_;
+	uint8_t wire_[Y_TRACE_TEST_BUFFERS_SIZE * 4];
+	uint32_t wire_size_;
+	uint32_t starts_[Y_TRACE_TEST_BUFFERS_SIZE];
+	uint32_t now_;
+	YBOOL replies_;
+	uint32_t handled_;
+};
+
+uint8_t YTraceTestReadByte(struct YProtocol *protocol)
+{
+	return 0;
+}
+
+void YTraceTestSendByte(struct YProtocol *protocol, uint8_t byte)
+{
+	struct YTraceTest *test = (struct YTraceTest*) YProtocolUserData(protocol);
+	
+	// Only encoder keeps its bytes, bytes of replies go nowhere
+	if (protocol == &test->encoder_ && test->wire_size_ < sizeof(test->wire_))
+	{
+		test->wire_[test->wire_size_++] = byte;
+	}
+}
+
+void YTraceTestEnableTransmit(struct YProtocol *protocol, YBOOL enabled)
+{
+}
+
+void YTraceTestTurnaround(struct YProtocol *protocol, YBOOL transmit)
+{
+}
+
+uint32_t YTraceTestNow(struct YProtocol *protocol)
+{
+	struct YTraceTest *test = (struct YTraceTest*) YProtocolUserData(protocol);
+	
+	return test->now_;
+}
+
+int32_t YTraceTestProcess(struct YProtocol *protocol)
+{
+	struct YTraceTest *test = (struct YTraceTest*) YProtocolUserData(protocol);
+	uint8_t reply = YProtocolFunctionCode(protocol);
+	
+	test->handled_++;
+	if (test->replies_ == YTRUE)
+	{
+		YProtocolSendPacket(protocol, reply, &reply, 1);
+	}
+	return Y_PARSE_IS_OK;
+}
+
+void YTraceTestInit(struct YTraceTest *test, uint8_t framing, uint32_t mode)
+{
+	memset(test, 0, sizeof(*test));
+	YProtocolInit(&test->encoder_, Y_TRACE_TEST_BUFFERS_SIZE, YTraceTestReadByte, YTraceTestSendByte,
+		YTraceTestProcess, YTraceTestEnableTransmit);
+	YProtocolSetFraming(&test->encoder_, framing);
+	YProtocolSetUserData(&test->encoder_, test);
+	
+	if (mode == Y_TRACE_TEST_HALF_DUPLEX)
+	{
+		YProtocolInitHalfDuplex(&test->reciever_, Y_TRACE_TEST_BUFFERS_SIZE, YTraceTestReadByte, YTraceTestSendByte,
+			YTraceTestProcess, YTraceTestEnableTransmit, YTraceTestTurnaround);
+	}
+	else
+	{
+		YProtocolInit(&test->reciever_, Y_TRACE_TEST_BUFFERS_SIZE, YTraceTestReadByte, YTraceTestSendByte,
+			YTraceTestProcess, YTraceTestEnableTransmit);
+	}
+	YProtocolSetFraming(&test->reciever_, framing);
+	YProtocolSetUserData(&test->reciever_, test);
+	YProtocolSetTraceTimer(&test->reciever_, YTraceTestNow);
+	if (mode == Y_TRACE_TEST_INTERRUPT)
+	{
+		YProtocolEnableInterruptParsing(&test->reciever_, YTRUE);
+	}
+}
+
+void YTraceTestDeinit(struct YTraceTest *test)
+{
+	YProtocolDeinit(&test->encoder_);
+	YProtocolDeinit(&test->reciever_);
+}
+
+void YTraceTestEncode(struct YTraceTest *test, uint32_t count)
+{
+	uint8_t data[Y_TRACE_TEST_DATA_SIZE];
+	uint32_t i;
+	
+	test->wire_size_ = 0;
+	for (i = 0; i < count; ++i)
+	{
+		memset(data, (int) i, sizeof(data));
+		test->starts_[i] = test->wire_size_;
+		YProtocolSendPacket(&test->encoder_, (uint8_t) (i + 1), data, sizeof(data));
+		while (YProtocolInterrupt(&test->encoder_, YFALSE) == Y_PARSE_IS_OK)
+		{
+		}
+	}
+}
+
+void YTraceTestReceive(struct YTraceTest *test, uint32_t first, uint32_t last)
+{
+	uint32_t i;
+	
+	// Every byte is recieved by its own interrupt, clock advances between bytes
+	for (i = first; i < last; ++i)
+	{
+		test->now_ += Y_TRACE_TEST_BYTE_TICKS;
+		YProtocolReceive(&test->reciever_, &test->wire_[i], 1);
+	}
+}
+
+void YTraceTestRun(struct YTraceTest *test)
+{
+	// Reply is transmitted completely before the next packet is parsed
+	do
+	{
+		while (YProtocolInterrupt(&test->reciever_, YFALSE) == Y_PARSE_IS_OK)
+		{
+		}
+	}
+	while (YProtocolThread(&test->reciever_) != Y_PARSE_FIFO_EMPTY);
+	while (YProtocolInterrupt(&test->reciever_, YFALSE) == Y_PARSE_IS_OK)
+	{
+	}
+}
+
+YBOOL YTraceTestQueued(struct YTraceTest *test)
+{
+	struct YProtocolTrace trace;
+	struct YProtocolTraceRecord *record;
+	uint32_t i, expected;
+	YBOOL passed = YTRUE;
+	
+	test->replies_ = YTRUE;
+	YTraceTestEncode(test, Y_TRACE_TEST_PACKETS);
+	YTraceTestReceive(test, 0, test->wire_size_);
+	test->now_ += 1000;
+	YTraceTestRun(test);
+	
+	YProtocolGetTrace(&test->reciever_, &trace);
+	if (trace.count_ != Y_TRACE_TEST_PACKETS || test->handled_ != Y_TRACE_TEST_PACKETS)
+	{
+		return YFALSE;
+	}
+	for (i = 0; i < Y_TRACE_TEST_PACKETS; ++i)
+	{
+		// Clock has advanced before first byte of packet
+		record = &trace.records_[i % YPROTOCOL_TRACE_SIZE];
+		expected = (test->starts_[i] + 1) * Y_TRACE_TEST_BYTE_TICKS;
+		if (record->rx_first_ != expected || record->fc_ != i + 1 || record->flags_ != (Y_TRACE_FLAG_RECEIVED |
+			Y_TRACE_FLAG_HANDLED | Y_TRACE_FLAG_REPLY | Y_TRACE_FLAG_SENT))
+		{
+			printf("  packet %u: rx_first %u expected %u, flags %u\n", i, record->rx_first_, expected, record->flags_);
+			passed = YFALSE;
+		}
+	}
+	return passed;
+}
+
+YBOOL YTraceTestStaleReply(struct YTraceTest *test)
+{
+	struct YProtocolTrace trace;
+	uint32_t i, count = YPROTOCOL_TRACE_SIZE + 2;
+	YBOOL passed = YTRUE;
+	
+	// The first packet is answered, its reply stays in outcoming FIFO while the others are handled
+	YTraceTestEncode(test, count);
+	test->replies_ = YTRUE;
+	YTraceTestReceive(test, 0, test->starts_[1]);
+	while (YProtocolThread(&test->reciever_) != Y_PARSE_FIFO_EMPTY)
+	{
+	}
+	test->replies_ = YFALSE;
+	YTraceTestReceive(test, test->starts_[1], test->wire_size_);
+	while (YProtocolThread(&test->reciever_) != Y_PARSE_FIFO_EMPTY)
+	{
+	}
+	while (YProtocolInterrupt(&test->reciever_, YFALSE) == Y_PARSE_IS_OK)
+	{
+	}
+	
+	YProtocolGetTrace(&test->reciever_, &trace);
+	if (trace.count_ != count || trace.histograms_[Y_TRACE_STAGE_REPLY][0] != 0)
+	{
+		passed = YFALSE;
+	}
+	for (i = 0; i < YPROTOCOL_TRACE_SIZE; ++i)
+	{
+		if (trace.records_[i].flags_ & (Y_TRACE_FLAG_REPLY | Y_TRACE_FLAG_SENT))
+		{
+			printf("  record %u: flags %u\n", i, trace.records_[i].flags_);
+			passed = YFALSE;
+		}
+	}
+	for (i = 0; i < YPROTOCOL_TRACE_BUCKETS; ++i)
+	{
+		if (trace.histograms_[Y_TRACE_STAGE_REPLY][i] != 0)
+		{
+			passed = YFALSE;
+		}
+	}
+	return passed;
+}
+
+int main(int argc, char **argv)
+{
+	static struct YTraceTest test;
+	struct YProtocolTrace trace;
+	uint32_t failed = 0;
+	uint32_t mode;
+	uint8_t framing;
+	YBOOL passed;
+	FILE *file;
+	
+	for (framing = Y_PROTOCOL_FRAMING_LENGTH; framing <= Y_PROTOCOL_FRAMING_COBS; ++framing)
+	{
+		for (mode = 0; mode < Y_TRACE_TEST_MODES; ++mode)
+		{
+			YTraceTestInit(&test, framing, mode);
+			passed = YTraceTestQueued(&test);
+			printf("%s queued %s %s\n", passed ? "ok" : "FAIL",
+				(framing == Y_PROTOCOL_FRAMING_COBS) ? "cobs" : "length", mode_names[mode]);
+			failed += (passed == YTRUE) ? 0 : 1;
+			YProtocolGetTrace(&test.reciever_, &trace);
+			YTraceTestDeinit(&test);
+		}
+	
+		YTraceTestInit(&test, framing, Y_TRACE_TEST_THREAD);
+		passed = YTraceTestStaleReply(&test);
+		printf("%s stale_reply %s\n", passed ? "ok" : "FAIL", (framing == Y_PROTOCOL_FRAMING_COBS) ? "cobs" : "length");
+		failed += (passed == YTRUE) ? 0 : 1;
+		YTraceTestDeinit(&test);
+	}
+	
+	if (argc > 1)
+	{
+		file = fopen(argv[1], "wb");
+		if (file == NULL || fwrite(&trace, sizeof(trace), 1, file) != 1)
+		{
+			perror(argv[1]);
+			failed++;
+		}
+		if (file != NULL)
+		{
+			fclose(file);
+		}
+	}
+	return (int) failed;
+}